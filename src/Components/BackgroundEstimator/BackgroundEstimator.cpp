@@ -11,9 +11,12 @@
 #include "Common/Logger.hpp"
 
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "opencv2/bgsegm.hpp"
 
+#include "Types/ForEach.hpp"
+
 
 namespace Processors {
 namespace BackgroundEstimator {
@@ -22,39 +25,160 @@ BackgroundEstimator::BackgroundEstimator(const std::string & name) :
 		Base::Component(name) , 
 		method("method", std::string("MOG"), "combo"), 
 		rate("rate", 20, "range"),
-		automatic("automatic", false) {
+		automatic("automatic", false),
+		async("async", false),
+		update_every("update.every", 1, "range"),
+		burst("burst", 0, "range"),
+		freeze("freeze", false),
+		output_mask("output.mask", true),
+		output_rle("output.rle", false),
+		threshold("threshold", 30, "range"),
+		sigma_delta_n("sigma_delta.n", 4, "range"),
+		snapshot_file("snapshot.file", std::string("")),
+		snapshot_camera("snapshot.camera", std::string("")),
+		snapshot_period("snapshot.period", 60, "range"),
+		streams("streams", 1, "range"),
+		pool_priority("pool.priority", 1, "range"),
+		pool_affinity("pool.affinity", std::string("")) {
 	
 	method.addConstraint("MOG");
 	method.addConstraint("MOG2");
 	method.addConstraint("GMG");
+	method.addConstraint("RunningAvg");
+	method.addConstraint("SigmaDelta");
 	registerProperty(method);
 	registerProperty(rate);
 	registerProperty(automatic);
+	registerProperty(async);
+	
+	// model is updated every N frames, other frames are only classified
+	update_every.addConstraint("1");
+	update_every.addConstraint("100");
+	registerProperty(update_every);
+	
+	// number of frames after reset with fast learning, decaying to normal rate
+	burst.addConstraint("0");
+	burst.addConstraint("1000");
+	registerProperty(burst);
+	
+	// RunningAvg, SigmaDelta - don't update model in foreground pixels
+	registerProperty(freeze);
+	
+	// full mask on out_img, run-length encoded mask with changed regions on out_rle and out_delta
+	registerProperty(output_mask);
+	registerProperty(output_rle);
 	
+	// RunningAvg - sum of absolute channel differences above which pixel is foreground
+	threshold.addConstraint("1");
+	threshold.addConstraint("765");
+	registerProperty(threshold);
 	
+	// SigmaDelta - amplification of difference in variance estimate
+	sigma_delta_n.addConstraint("1");
+	sigma_delta_n.addConstraint("16");
+	registerProperty(sigma_delta_n);
 	
-	reset_flag = false;
+	// background snapshot, loaded on start if it was taken by the same camera
+	registerProperty(snapshot_file);
+	registerProperty(snapshot_camera);
+	// interval between periodic snapshots in seconds, 0 - only on stop
+	snapshot_period.addConstraint("0");
+	snapshot_period.addConstraint("3600");
+	registerProperty(snapshot_period);
+	
+	// number of cameras processed by this instance, as one batch per tick
+	streams.addConstraint("1");
+	streams.addConstraint("16");
+	registerProperty(streams);
+	
+	// priority (0 - low, 2 - high) and cores (e.g. "0-3,6", empty - any) of pool tasks
+	pool_priority.addConstraint("0");
+	pool_priority.addConstraint("2");
+	registerProperty(pool_priority);
+	registerProperty(pool_affinity);
+	
+	resets = 0;
+	trace_stage = -1;
 }
 
 BackgroundEstimator::~BackgroundEstimator() {
+	worker.stop();
+	
+	for (size_t k = 1; k < channels.size(); ++k) {
+		delete channels[k].in_img;
+		delete channels[k].in_stamp;
+		delete channels[k].out_img;
+		delete channels[k].out_rle;
+		delete channels[k].out_delta;
+		delete channels[k].out_stamp;
+	}
 }
 
 void BackgroundEstimator::prepareInterface() {
+	channels.resize(std::max<int>(streams, 1));
+	for (size_t k = 0; k < channels.size(); ++k)
+		channels[k].index = k;
+	snapshot_written.assign(channels.size(), 0);
+	channels[0].in_img = &in_img;
+	channels[0].in_stamp = &in_stamp;
+	channels[0].out_img = &out_img;
+	channels[0].out_rle = &out_rle;
+	channels[0].out_delta = &out_delta;
+	channels[0].out_stamp = &out_stamp;
+	
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_img", &in_img);
+	registerStream("in_stamp", &in_stamp);
 	registerStream("out_img", &out_img);
+	registerStream("out_stamp", &out_stamp);
+	registerStream("out_dropped", &out_dropped);
+	registerStream("out_age", &out_age);
+	registerStream("out_rle", &out_rle);
+	registerStream("out_delta", &out_delta);
+	
+	for (size_t k = 1; k < channels.size(); ++k) {
+		Channel & c = channels[k];
+		std::string n = boost::lexical_cast<std::string>(k);
+		c.in_img = new Base::DataStreamIn<cv::Mat>;
+		c.in_stamp = new Base::DataStreamIn<Types::Stamp>;
+		c.out_img = new Base::DataStreamOut<cv::Mat>;
+		c.out_rle = new Base::DataStreamOut<Types::RleMask>;
+		c.out_delta = new Base::DataStreamOut<std::vector<cv::Rect> >;
+		c.out_stamp = new Base::DataStreamOut<Types::Stamp>;
+		registerStream("in_img" + n, c.in_img);
+		registerStream("in_stamp" + n, c.in_stamp);
+		registerStream("out_img" + n, c.out_img);
+		registerStream("out_rle" + n, c.out_rle);
+		registerStream("out_delta" + n, c.out_delta);
+		registerStream("out_stamp" + n, c.out_stamp);
+	}
+	
 	// Register handlers
-	registerHandler("onNewImage", boost::bind(&BackgroundEstimator::onNewImage, this));
-	addDependency("onNewImage", &in_img);
+	if (channels.size() > 1) {
+		// all cameras of a tick are processed together
+		registerHandler("onNewImages", boost::bind(&BackgroundEstimator::onNewImages, this));
+		for (size_t k = 0; k < channels.size(); ++k)
+			addDependency("onNewImages", channels[k].in_img);
+	} else {
+		registerHandler("onNewImage", boost::bind(&BackgroundEstimator::onNewImage, this));
+		addDependency("onNewImage", &in_img);
+	}
 	registerHandler("reset", boost::bind(&BackgroundEstimator::reset, this));
 
 }
 
 bool BackgroundEstimator::onInit() {
 	//create Background Subtractor objects
-	pMOG = cv::bgsegm::createBackgroundSubtractorMOG(); //MOG approach
-	pMOG2 = cv::createBackgroundSubtractorMOG2(); //MOG2 approach
-	pGMG = cv::bgsegm::createBackgroundSubtractorGMG(); //GMG approach
+	for (size_t k = 0; k < channels.size(); ++k) {
+		Channel & c = channels[k];
+		c.pMOG = cv::bgsegm::createBackgroundSubtractorMOG(); //MOG approach
+		c.pMOG2 = cv::createBackgroundSubtractorMOG2(); //MOG2 approach
+		c.pGMG = cv::bgsegm::createBackgroundSubtractorGMG(); //GMG approach
+		c.pAvg = cv::makePtr<RunningAverage>(); //running average approach
+		c.pSD = cv::makePtr<SigmaDelta>(); //sigma-delta approach
+	}
+	
+	trace_stage = Types::Trace::stage(name());
 	return true;
 }
 
@@ -63,37 +187,262 @@ bool BackgroundEstimator::onFinish() {
 }
 
 bool BackgroundEstimator::onStop() {
+	worker.stop();
+	try {
+		snapshot_writes.wait();
+	} catch (const std::exception & e) {
+		CLOG(LWARNING) << "BackgroundEstimator: snapshot write failed: " << e.what();
+	}
+	if (!std::string(snapshot_file).empty())
+		for (size_t k = 0; k < channels.size(); ++k)
+			saveSnapshot(channels[k]);
 	return true;
 }
 
 bool BackgroundEstimator::onStart() {
+	if (!std::string(snapshot_file).empty())
+		for (size_t k = 0; k < channels.size(); ++k)
+			loadSnapshot(channels[k]);
+	
+	if (async && channels.size() > 1)
+		CLOG(LWARNING) << "BackgroundEstimator: async mode is not supported with multiple streams, batches are processed synchronously";
+	else if (async)
+		worker.start(boost::bind(&BackgroundEstimator::processStamped, this, _1));
 	return true;
 }
 
 void BackgroundEstimator::onNewImage() {
-	cv::Mat frame = in_img.read();
+	Channel & c = channels[0];
+	StampedMat frame(in_img.read(), Types::Trace::readStamp(in_stamp, c.stamp_seq));
+	
+	if (!worker.isRunning()) {
+		StampedMat mask = processStamped(frame);
+		publish(c, mask.first, mask.second);
+		return;
+	}
+	
+	// async mode - hand the frame over and publish whatever is ready
+	worker.push(frame);
+	StampedMat mask;
+	if (worker.pop(mask)) {
+		publish(c, mask.first, mask.second);
+		out_dropped.write(worker.droppedCount());
+		out_age.write(worker.resultAge());
+	}
+}
+
+void BackgroundEstimator::onNewImages() {
+	Types::ThreadPool::Context pool(pool_priority, Types::ThreadPool::parseAffinity(pool_affinity));
+	
+	// streams are read and written on executor thread, only models are updated in parallel
+	batch.resize(channels.size());
+	for (size_t k = 0; k < channels.size(); ++k) {
+		Channel & c = channels[k];
+		Types::Stamp stamp = Types::Trace::readStamp(*c.in_stamp, c.stamp_seq);
+		batch[k] = StampedMat(c.in_img->read(), stamp);
+	}
+	
+	Types::ThreadPool::instance().parallelFor(cv::Range(0, batch.size()), Types::ForEach(boost::bind(&BackgroundEstimator::processBatch, this, _1)), batch.size());
+	
+	for (size_t k = 0; k < channels.size(); ++k)
+		publish(channels[k], batch[k].first, batch[k].second);
+}
+
+void BackgroundEstimator::processBatch(int k) {
+	Types::Trace::Scope trace(trace_stage, batch[k].second);
+	batch[k].first = process(channels[k], batch[k].first);
+}
+
+cv::Mat BackgroundEstimator::process(Channel & c, const cv::Mat & frame) {
 	float r = 0.01f * rate;
 	if (automatic) {
 		r = -1;
 	}
-	if (reset_flag) {
-		r = 1;
-		reset_flag = false;
+	unsigned requested = resets;
+	if (c.resets_seen != requested) {
+		c.burst_frame = 0;
+		c.resets_seen = requested;
+	}
+	
+	if (c.burst_frame >= 0) {
+		// rate 1/(k+1) makes the model an average of frames seen since reset,
+		// until it drops to the normal rate
+		float b = 1.0f / (c.burst_frame + 1);
+		if (r < 0 || b > r)
+			r = b;
+		if (++c.burst_frame >= std::max<int>(burst, 1))
+			c.burst_frame = -1;
+	} else if (++c.update_counter % update_every != 0) {
+		// frame is only classified, model is left untouched
+		r = 0;
 	}
 	
 	if (method == "MOG")
-		pSub = pMOG;
+		c.pSub = c.pMOG;
 	if (method == "MOG2")
-		pSub = pMOG2;
+		c.pSub = c.pMOG2;
 	if (method == "GMG")
-		pSub = pGMG;
+		c.pSub = c.pGMG;
+	if (method == "RunningAvg")
+		c.pSub = c.pAvg;
+	if (method == "SigmaDelta")
+		c.pSub = c.pSD;
+	
+	c.pAvg->setThreshold(threshold);
+	c.pSD->setAmplification(sigma_delta_n);
+	c.pAvg->setSelective(freeze);
+	c.pSD->setSelective(freeze);
+	
+	// snapshot is applied to the first frame, if resolution matches
+	cv::Ptr<StateSubtractor> state = c.pSub.dynamicCast<StateSubtractor>();
+	if (!c.seed_img.empty()) {
+		if (c.seed_img.size() != frame.size() || c.seed_img.type() != frame.type())
+			CLOG(LWARNING) << "BackgroundEstimator: snapshot resolution doesn't match camera, ignored";
+		else if (!state || c.seed_method != std::string(method) || !state->setState(c.seed_state, frame.size(), frame.type()))
+			seedModel(c, c.seed_img);
+		c.seed_img.release();
+		c.seed_state.clear();
+	}
+	
+	// mask is published without copying, so it's replaced by another arena buffer while receivers still hold it
+	Types::FrameArena::acquire(c.fgMaskMOG2, frame.size(), CV_8UC1);
+	c.pSub->apply(frame, c.fgMaskMOG2, r);
+	
+	if (!std::string(snapshot_file).empty()) {
+		// MOG2 and own methods provide background image, for other methods it's estimated from background pixels
+		if (c.pSub != c.pMOG2 && !state && r != 0) {
+			if (c.bg_estimate.size() != frame.size() || c.bg_estimate.channels() != frame.channels())
+				frame.convertTo(c.bg_estimate, CV_MAKETYPE(CV_32F, frame.channels()));
+			cv::compare(c.fgMaskMOG2, 0, c.bg_mask, cv::CMP_EQ);
+			cv::accumulateWeighted(frame, c.bg_estimate, r > 0 ? r : 0.05, c.bg_mask);
+		}
+		
+		double ticks = (double) cv::getTickCount();
+		if (snapshot_period > 0 && (ticks - c.last_save) / cv::getTickFrequency() > snapshot_period) {
+			// only copies are made on frame path, file is written by low priority pool task
+			Snapshot snapshot;
+			if (takeSnapshot(c, snapshot)) {
+				Types::ThreadPool::Context low(Types::ThreadPool::Low, Types::ThreadPool::parseAffinity(pool_affinity));
+				snapshot_writes.run(boost::bind(&BackgroundEstimator::writeSnapshot, this, c.index, snapshot, ticks));
+			}
+			c.last_save = ticks;
+		}
+	}
+	
+	return c.fgMaskMOG2;
+}
+
+BackgroundEstimator::StampedMat BackgroundEstimator::processStamped(const StampedMat & frame) {
+	Types::ThreadPool::Context pool(pool_priority, Types::ThreadPool::parseAffinity(pool_affinity));
+	Types::Trace::Scope trace(trace_stage, frame.second);
+	return StampedMat(process(channels[0], frame.first), frame.second);
+}
+
+void BackgroundEstimator::publish(Channel & c, const cv::Mat & mask, const Types::Stamp & stamp) {
+	c.out_stamp->write(stamp);
+	
+	if (output_mask)
+		c.out_img->write(mask);
+	
+	if (output_rle) {
+		c.rle.encode(mask);
+		Types::RleMask::diff(c.prev_rle, c.rle, c.delta);
+		c.out_rle->write(c.rle);
+		c.out_delta->write(c.delta);
+		std::swap(c.rle, c.prev_rle);
+	}
+}
+
+cv::Mat BackgroundEstimator::backgroundImage(Channel & c) {
+	cv::Mat bg;
+	if (c.pSub && (c.pSub == c.pMOG2 || c.pSub.dynamicCast<StateSubtractor>()))
+		c.pSub->getBackgroundImage(bg);
+	else if (!c.bg_estimate.empty())
+		c.bg_estimate.convertTo(bg, CV_8U);
+	return bg;
+}
+
+void BackgroundEstimator::seedModel(Channel & c, const cv::Mat & bg) {
+	cv::Mat tmp;
+	if (c.pSub == c.pGMG) {
+		// GMG gives no mask until it has seen enough frames
+		cv::Ptr<cv::bgsegm::BackgroundSubtractorGMG> gmg = c.pGMG.dynamicCast<cv::bgsegm::BackgroundSubtractorGMG>();
+		int frames = gmg ? gmg->getNumFrames() : 1;
+		for (int i = 0; i < frames; ++i)
+			c.pSub->apply(bg, tmp);
+	} else {
+		c.pSub->apply(bg, tmp, 1);
+	}
+	bg.convertTo(c.bg_estimate, CV_MAKETYPE(CV_32F, bg.channels()));
+}
+
+std::string BackgroundEstimator::snapshotFile(int k) {
+	std::string file = snapshot_file;
+	return k == 0 ? file : file + "." + boost::lexical_cast<std::string>(k);
+}
+
+std::string BackgroundEstimator::snapshotCamera(int k) {
+	std::string camera = snapshot_camera;
+	return k == 0 ? camera : camera + "#" + boost::lexical_cast<std::string>(k);
+}
+
+void BackgroundEstimator::loadSnapshot(Channel & c) {
+	// periods of channels are shifted evenly, so that cameras of one batch don't save in the same tick
+	c.last_save = (double) cv::getTickCount() - (double) c.index * snapshot_period * cv::getTickFrequency() / channels.size();
+	
+	Snapshot snapshot;
+	if (!snapshot.load(snapshotFile(c.index)))
+		return;
+	
+	if (snapshot.camera == snapshotCamera(c.index) && !snapshot.mats.empty()) {
+		c.seed_img = snapshot.mats[0];
+		c.seed_state.assign(snapshot.mats.begin() + 1, snapshot.mats.end());
+		c.seed_method = snapshot.method;
+		CLOG(LINFO) << "BackgroundEstimator: loaded snapshot of " << snapshot.method << " model";
+	} else {
+		CLOG(LWARNING) << "BackgroundEstimator: snapshot taken by camera " << snapshot.camera << ", ignored";
+	}
+}
+
+void BackgroundEstimator::saveSnapshot(Channel & c) {
+	Snapshot snapshot;
+	if (takeSnapshot(c, snapshot))
+		writeSnapshot(c.index, snapshot, (double) cv::getTickCount());
+}
+
+bool BackgroundEstimator::takeSnapshot(Channel & c, Snapshot & snapshot) {
+	snapshot.method = std::string(method);
+	snapshot.camera = snapshotCamera(c.index);
+	cv::Mat bg = backgroundImage(c);
+	if (bg.empty())
+		return false;
+	snapshot.mats.push_back(bg);
+	
+	// own methods store exact state after background image
+	cv::Ptr<StateSubtractor> state = c.pSub.dynamicCast<StateSubtractor>();
+	if (state) {
+		std::vector<cv::Mat> mats;
+		state->getState(mats);
+		snapshot.mats.insert(snapshot.mats.end(), mats.begin(), mats.end());
+	}
+	return true;
+}
+
+void BackgroundEstimator::writeSnapshot(int k, const Snapshot & snapshot, double ticks) {
+	boost::mutex::scoped_lock lock(snapshot_mutex);
+	
+	// pool may run writes out of order, older snapshot mustn't replace newer one
+	if (ticks < snapshot_written[k])
+		return;
+	snapshot_written[k] = ticks;
 	
-	pSub->apply(frame, fgMaskMOG2, r);
-	out_img.write(fgMaskMOG2.clone());
+	if (!snapshot.save(snapshotFile(k)))
+		CLOG(LWARNING) << "BackgroundEstimator: can't write snapshot " << snapshotFile(k);
 }
 
 void BackgroundEstimator::reset() {
-	reset_flag = true;
+	// channels notice new request on their next frame, on whichever thread processes it
+	++resets;
 }
 
 
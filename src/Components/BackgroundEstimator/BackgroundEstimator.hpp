@@ -13,8 +13,22 @@
 #include "Base/Property.hpp"
 #include "Base/EventHandler2.hpp"
 
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include <opencv2/opencv.hpp>
 
+#include "Types/AsyncProcessor.hpp"
+#include "Types/RleMask.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+#include "Types/ThreadPool.hpp"
+#include "Types/FrameArena.hpp"
+
+#include "Snapshot.hpp"
+#include "FastSubtractors.hpp"
+#include "Channel.hpp"
+
 
 namespace Processors {
 namespace BackgroundEstimator {
@@ -68,10 +82,24 @@ protected:
 
 
 	// Input data streams
+	/// Frames of the first camera, further cameras use in_img1, in_img2, ...
 	Base::DataStreamIn<cv::Mat> in_img;
+	/// Capture time and number of frames on in_img (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
 
 	// Output data streams
+	/// Stamp of the frame mask on out_img/out_rle was computed from
+	Base::DataStreamOut<Types::Stamp> out_stamp;
 	Base::DataStreamOut<cv::Mat> out_img;
+	Base::DataStreamOut<int> out_dropped;
+	Base::DataStreamOut<double> out_age;
+	Base::DataStreamOut<Types::RleMask> out_rle;
+	/// Regions where mask changed since previous frame
+	Base::DataStreamOut<std::vector<cv::Rect> > out_delta;
+	/*
+	 * Streams of further cameras (in_imgN, in_stampN, out_imgN, out_rleN, out_deltaN,
+	 * out_stampN) are created in prepareInterface and owned by channels.
+	 */
 
 	// Handlers
 
@@ -79,19 +107,108 @@ protected:
 	Base::Property<std::string> method;
 	Base::Property<int> rate;
 	Base::Property<bool> automatic;
-	
-	int reset_flag;
+	Base::Property<bool> async;
+	Base::Property<int> update_every;
+	Base::Property<int> burst;
+	Base::Property<bool> freeze;
+	Base::Property<bool> output_mask;
+	Base::Property<bool> output_rle;
+	Base::Property<int> threshold;
+	Base::Property<int> sigma_delta_n;
+	Base::Property<std::string> snapshot_file;
+	Base::Property<std::string> snapshot_camera;
+	Base::Property<int> snapshot_period;
+	Base::Property<int> streams;
+	Base::Property<int> pool_priority;
+	Base::Property<std::string> pool_affinity;
 	
 	// Handlers
 	void onNewImage();
+	void onNewImages();
 	void reset();
-
-	cv::Mat fgMaskMOG2; //fg mask fg mask generated by MOG2 method
-	cv::Ptr<cv::BackgroundSubtractor> pMOG; //MOG2 Background subtractor
-	cv::Ptr<cv::BackgroundSubtractor> pMOG2; //MOG2 Background subtractor
-	cv::Ptr<cv::BackgroundSubtractor> pCNT; //CNT Background subtractor
-	cv::Ptr<cv::BackgroundSubtractor> pGMG; //GMG Background subtractor
-	cv::Ptr<cv::BackgroundSubtractor> pSub; //MOG2 Background subtractor
+	
+	/*!
+	 * Updates background model of channel with given frame and returns foreground mask.
+	 */
+	cv::Mat process(Channel & c, const cv::Mat & frame);
+	
+	/// Frame or mask with stamp of the camera frame
+	typedef std::pair<cv::Mat, Types::Stamp> StampedMat;
+	
+	/*!
+	 * Runs process() on stamped frame of the first channel, recording it in the trace.
+	 */
+	StampedMat processStamped(const StampedMat & frame);
+	
+	/*!
+	 * Processes frame of k-th channel from current batch (parallel loop body).
+	 */
+	void processBatch(int k);
+	
+	/*!
+	 * Writes mask to enabled outputs of channel.
+	 */
+	void publish(Channel & c, const cv::Mat & mask, const Types::Stamp & stamp);
+	
+	/*!
+	 * Current background image, from the model if it provides one or from own estimate.
+	 */
+	cv::Mat backgroundImage(Channel & c);
+	
+	/*!
+	 * Initializes active model with background image from snapshot.
+	 */
+	void seedModel(Channel & c, const cv::Mat & bg);
+	
+	/*!
+	 * Loads snapshot of channel, if there is one for its camera.
+	 */
+	void loadSnapshot(Channel & c);
+	
+	/*!
+	 * Writes background snapshot of channel to file set in properties.
+	 */
+	void saveSnapshot(Channel & c);
+	
+	/*!
+	 * Copies background and model state of channel into snapshot.
+	 * \returns false if there is no background yet
+	 */
+	bool takeSnapshot(Channel & c, Snapshot & snapshot);
+	
+	/*!
+	 * Writes snapshot of k-th channel taken at given time (ticks), unless newer one was already written.
+	 */
+	void writeSnapshot(int k, const Snapshot & snapshot, double ticks);
+	
+	/*!
+	 * Snapshot file and camera identifier of k-th channel - the first channel
+	 * uses properties as they are, further ones append channel number.
+	 */
+	std::string snapshotFile(int k);
+	std::string snapshotCamera(int k);
+	
+	/// Per-camera state, the first channel uses component's own streams
+	std::vector<Channel> channels;
+	
+	/// Frames and masks of the batch being processed
+	std::vector<StampedMat> batch;
+	
+	/// Worker used for background updates in async mode
+	Types::AsyncProcessor<StampedMat, StampedMat> worker;
+	
+	/// Number of reset requests, written by reset handler and read by (possibly async) process()
+	boost::atomic<unsigned> resets;
+	
+	/// Guards snapshot files and times (ticks) of last snapshots written for each channel
+	boost::mutex snapshot_mutex;
+	std::vector<double> snapshot_written;
+	
+	/// Periodic snapshot writes, run as low priority pool tasks
+	Types::TaskGroup snapshot_writes;
+	
+	/// Trace stage id
+	int trace_stage;
 
 };
 
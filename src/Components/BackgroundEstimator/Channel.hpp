@@ -0,0 +1,84 @@
+/*!
+ * \file
+ * \brief Per-camera state of background estimation
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef CHANNEL_HPP_
+#define CHANNEL_HPP_
+
+#include <string>
+#include <vector>
+
+#include "Base/DataStream.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include "Types/RleMask.hpp"
+#include "Types/Stamp.hpp"
+
+#include "FastSubtractors.hpp"
+
+namespace Processors {
+namespace BackgroundEstimator {
+
+/*!
+ * \struct Channel
+ * \brief Streams, background models and outputs of single camera.
+ *
+ * Channels don't share any mutable state, so channels of one batch can be
+ * processed concurrently.
+ */
+struct Channel {
+	/// Position of channel in component (camera number)
+	int index;
+
+	/// Streams of the channel, owned by component
+	Base::DataStreamIn<cv::Mat> * in_img;
+	Base::DataStreamIn<Types::Stamp> * in_stamp;
+	Base::DataStreamOut<cv::Mat> * out_img;
+	Base::DataStreamOut<Types::RleMask> * out_rle;
+	Base::DataStreamOut<std::vector<cv::Rect> > * out_delta;
+	Base::DataStreamOut<Types::Stamp> * out_stamp;
+
+	cv::Mat fgMaskMOG2; //fg mask fg mask generated by MOG2 method
+	cv::Ptr<cv::BackgroundSubtractor> pMOG; //MOG2 Background subtractor
+	cv::Ptr<cv::BackgroundSubtractor> pMOG2; //MOG2 Background subtractor
+	cv::Ptr<cv::BackgroundSubtractor> pGMG; //GMG Background subtractor
+	cv::Ptr<RunningAverage> pAvg; //Running average Background subtractor
+	cv::Ptr<SigmaDelta> pSD; //Sigma-delta Background subtractor
+	cv::Ptr<cv::BackgroundSubtractor> pSub; //MOG2 Background subtractor
+
+	/// Number of component reset requests already applied to this channel
+	unsigned resets_seen;
+	/// Frame index within learning burst after reset, -1 outside burst
+	int burst_frame;
+	/// Frames since start, for update decimation
+	int update_counter;
+
+	/// Encoded current and previous mask
+	Types::RleMask rle, prev_rle;
+	std::vector<cv::Rect> delta;
+
+	/// Background image loaded from snapshot, waiting for the first frame
+	cv::Mat seed_img;
+	/// Exact model state from snapshot and method it belongs to
+	std::vector<cv::Mat> seed_state;
+	std::string seed_method;
+	/// Running estimate of background for methods that don't expose it
+	cv::Mat bg_estimate, bg_mask;
+	/// Time of last periodic snapshot (in ticks)
+	double last_save;
+
+	/// Number of the next frame without stamp
+	uint32_t stamp_seq;
+
+	Channel() : index(0), in_img(NULL), in_stamp(NULL), out_img(NULL), out_rle(NULL), out_delta(NULL), out_stamp(NULL),
+			resets_seen(0), burst_frame(-1), update_counter(0), last_save(0), stamp_seq(0) {
+	}
+};
+
+} //: namespace BackgroundEstimator
+} //: namespace Processors
+
+#endif /* CHANNEL_HPP_ */
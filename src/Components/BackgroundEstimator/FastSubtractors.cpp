@@ -0,0 +1,202 @@
+/*!
+ * \file
+ * \brief Lightweight background subtractors with compact per-pixel state
+ * \author Maciej Stefańczyk
+ */
+
+#include "FastSubtractors.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace Processors {
+namespace BackgroundEstimator {
+
+namespace {
+
+/// Rate used when automatic learning rate is requested
+const double default_rate = 0.05;
+
+/*!
+ * Single row of running average. Rate a is in 1/256 units, threshold in 8.8 fixed point.
+ * In selective mode foreground pixels keep their background.
+ */
+template <int CN, bool SELECTIVE>
+void runningAverageRow(const uchar * src, ushort * bg, uchar * dst, int width, int a, int thr) {
+	for (int x = 0; x < width; ++x) {
+		int d[CN];
+		int sum = 0;
+		for (int c = 0; c < CN; ++c) {
+			d[c] = (src[x * CN + c] << 8) - bg[x * CN + c];
+			sum += std::abs(d[c]);
+		}
+		int fg = sum > thr;
+		int upd = SELECTIVE ? 1 - fg : 1;
+		for (int c = 0; c < CN; ++c)
+			bg[x * CN + c] += upd * ((d[c] * a) >> 8);
+		dst[x] = fg * 255;
+	}
+}
+
+/*!
+ * Single row of sigma-delta, written without branches. Pixels are classified
+ * against current model, then model moves towards the frame where upd is set.
+ */
+template <int CN, bool SELECTIVE>
+void sigmaDeltaRow(const uchar * src, uchar * med, uchar * var, uchar * dst, int width, int n, int update) {
+	for (int x = 0; x < width; ++x) {
+		int fg = 0;
+		for (int c = 0; c < CN; ++c)
+			fg |= std::abs(src[x * CN + c] - med[x * CN + c]) > var[x * CN + c];
+
+		int upd = SELECTIVE ? update & (1 - fg) : update;
+		for (int c = 0; c < CN; ++c) {
+			int i = src[x * CN + c];
+			int m = med[x * CN + c];
+			m += upd * ((m < i) - (m > i));
+			int d = std::abs(i - m);
+			int v = var[x * CN + c];
+			int nd = n * d;
+			v += upd * (d != 0) * ((v < nd) - (v > nd));
+			v = std::min(std::max(v, 2), 255);
+			med[x * CN + c] = m;
+			var[x * CN + c] = v;
+		}
+		dst[x] = fg * 255;
+	}
+}
+
+/*!
+ * Number of rows and their width for a set of images - continuous images are processed as single row.
+ */
+void layout(const cv::Mat & a, const cv::Mat & b, const cv::Mat & c, int & rows, int & width) {
+	rows = a.rows;
+	width = a.cols;
+	if (a.isContinuous() && b.isContinuous() && c.isContinuous()) {
+		width *= rows;
+		rows = 1;
+	}
+}
+
+} //: namespace
+
+RunningAverage::RunningAverage() :
+		m_threshold(30) {
+}
+
+void RunningAverage::apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate) {
+	cv::Mat img = image.getMat();
+	int cn = img.channels();
+	CV_Assert(img.depth() == CV_8U && (cn == 1 || cn == 3 || cn == 4));
+
+	if (learningRate < 0)
+		learningRate = default_rate;
+	if (m_bg.size() != img.size() || m_bg.channels() != cn)
+		learningRate = 1;
+
+	fgmask.create(img.size(), CV_8U);
+	cv::Mat mask = fgmask.getMat();
+
+	if (learningRate >= 1) {
+		img.convertTo(m_bg, CV_MAKETYPE(CV_16U, cn), 256);
+		mask.setTo(0);
+		return;
+	}
+
+	int a = std::max(0, std::min(256, cvRound(learningRate * 256)));
+	int thr = m_threshold << 8;
+	int rows, width;
+	layout(img, m_bg, mask, rows, width);
+	for (int y = 0; y < rows; ++y) {
+		const uchar * src = img.ptr<uchar>(y);
+		ushort * bg = m_bg.ptr<ushort>(y);
+		uchar * dst = mask.ptr<uchar>(y);
+		switch (cn * 2 + m_selective) {
+		case 2: runningAverageRow<1, false>(src, bg, dst, width, a, thr); break;
+		case 3: runningAverageRow<1, true>(src, bg, dst, width, a, thr); break;
+		case 6: runningAverageRow<3, false>(src, bg, dst, width, a, thr); break;
+		case 7: runningAverageRow<3, true>(src, bg, dst, width, a, thr); break;
+		case 8: runningAverageRow<4, false>(src, bg, dst, width, a, thr); break;
+		case 9: runningAverageRow<4, true>(src, bg, dst, width, a, thr); break;
+		}
+	}
+}
+
+void RunningAverage::getBackgroundImage(cv::OutputArray backgroundImage) const {
+	m_bg.convertTo(backgroundImage, CV_MAKETYPE(CV_8U, m_bg.channels()), 1.0 / 256);
+}
+
+void RunningAverage::getState(std::vector<cv::Mat> & state) const {
+	state.clear();
+	state.push_back(m_bg.clone());
+}
+
+bool RunningAverage::setState(const std::vector<cv::Mat> & state, cv::Size size, int type) {
+	if (state.size() != 1 || state[0].size() != size || state[0].type() != CV_MAKETYPE(CV_16U, CV_MAT_CN(type)))
+		return false;
+	state[0].copyTo(m_bg);
+	return true;
+}
+
+SigmaDelta::SigmaDelta() :
+		m_n(4) {
+}
+
+void SigmaDelta::apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate) {
+	cv::Mat img = image.getMat();
+	int cn = img.channels();
+	CV_Assert(img.depth() == CV_8U && (cn == 1 || cn == 3 || cn == 4));
+
+	fgmask.create(img.size(), CV_8U);
+	cv::Mat mask = fgmask.getMat();
+
+	if (learningRate >= 1 || m_median.size() != img.size() || m_median.channels() != cn) {
+		img.copyTo(m_median);
+		m_variance.create(img.size(), img.type());
+		m_variance.setTo(2);
+		mask.setTo(0);
+		return;
+	}
+
+	int update = learningRate != 0;
+	int rows, width;
+	layout(img, m_median, mask, rows, width);
+	for (int y = 0; y < rows; ++y) {
+		const uchar * src = img.ptr<uchar>(y);
+		uchar * med = m_median.ptr<uchar>(y);
+		uchar * var = m_variance.ptr<uchar>(y);
+		uchar * dst = mask.ptr<uchar>(y);
+		switch (cn * 2 + m_selective) {
+		case 2: sigmaDeltaRow<1, false>(src, med, var, dst, width, m_n, update); break;
+		case 3: sigmaDeltaRow<1, true>(src, med, var, dst, width, m_n, update); break;
+		case 6: sigmaDeltaRow<3, false>(src, med, var, dst, width, m_n, update); break;
+		case 7: sigmaDeltaRow<3, true>(src, med, var, dst, width, m_n, update); break;
+		case 8: sigmaDeltaRow<4, false>(src, med, var, dst, width, m_n, update); break;
+		case 9: sigmaDeltaRow<4, true>(src, med, var, dst, width, m_n, update); break;
+		}
+	}
+}
+
+void SigmaDelta::getBackgroundImage(cv::OutputArray backgroundImage) const {
+	m_median.copyTo(backgroundImage);
+}
+
+void SigmaDelta::getState(std::vector<cv::Mat> & state) const {
+	state.clear();
+	state.push_back(m_median.clone());
+	state.push_back(m_variance.clone());
+}
+
+bool SigmaDelta::setState(const std::vector<cv::Mat> & state, cv::Size size, int type) {
+	if (state.size() != 2)
+		return false;
+	for (int i = 0; i < 2; ++i)
+		if (state[i].size() != size || state[i].type() != type)
+			return false;
+	state[0].copyTo(m_median);
+	state[1].copyTo(m_variance);
+	return true;
+}
+
+} //: namespace BackgroundEstimator
+} //: namespace Processors
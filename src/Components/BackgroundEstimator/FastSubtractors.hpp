@@ -0,0 +1,115 @@
+/*!
+ * \file
+ * \brief Lightweight background subtractors with compact per-pixel state
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef FASTSUBTRACTORS_HPP_
+#define FASTSUBTRACTORS_HPP_
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace Processors {
+namespace BackgroundEstimator {
+
+/*!
+ * \class StateSubtractor
+ * \brief Background subtractor with state that can be stored and restored exactly.
+ */
+class StateSubtractor : public cv::BackgroundSubtractor {
+public:
+	/*!
+	 * Copies model state to given list of matrices.
+	 */
+	virtual void getState(std::vector<cv::Mat> & state) const = 0;
+
+	/*!
+	 * Restores model state.
+	 * \returns false if state doesn't match the model or given frame size
+	 */
+	virtual bool setState(const std::vector<cv::Mat> & state, cv::Size size, int type) = 0;
+
+	/*!
+	 * Enables selective update - model is not updated in pixels classified as foreground.
+	 */
+	void setSelective(bool selective) { m_selective = selective; }
+
+protected:
+	StateSubtractor() : m_selective(false) {}
+
+	bool m_selective;
+};
+
+/*!
+ * \class RunningAverage
+ * \brief Exponential running average of the scene.
+ *
+ * Background is kept in 16-bit fixed point (8 fractional bits) per channel.
+ * Model update and thresholding are done in single pass over the image, with
+ * integer loops simple enough for the compiler to vectorize. Pixel is foreground
+ * when sum of absolute differences over channels exceeds threshold.
+ * Learning rate 0 only classifies pixels, without touching the model.
+ */
+class RunningAverage : public StateSubtractor {
+public:
+	RunningAverage();
+
+	/*!
+	 * Updates background and computes foreground mask.
+	 * \param learningRate in range [0, 1], 1 reinitializes the model, negative - default rate
+	 */
+	void apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate = -1);
+
+	void getBackgroundImage(cv::OutputArray backgroundImage) const;
+
+	void getState(std::vector<cv::Mat> & state) const;
+
+	bool setState(const std::vector<cv::Mat> & state, cv::Size size, int type);
+
+	void setThreshold(int threshold) { m_threshold = threshold; }
+
+private:
+	/// Background, CV_16UC(channels)
+	cv::Mat m_bg;
+	int m_threshold;
+};
+
+/*!
+ * \class SigmaDelta
+ * \brief Sigma-delta approximate median background.
+ *
+ * Background estimate M moves by one towards each new frame, which converges
+ * to temporal median. Variance estimate V moves by one towards N times absolute
+ * difference |I - M|. Pixel is foreground when difference exceeds V in any
+ * channel. Both estimates are 8-bit per channel.
+ */
+class SigmaDelta : public StateSubtractor {
+public:
+	SigmaDelta();
+
+	/*!
+	 * Updates background and computes foreground mask.
+	 * \param learningRate 1 reinitializes the model, 0 disables update, other values are ignored (update speed is fixed)
+	 */
+	void apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate = -1);
+
+	void getBackgroundImage(cv::OutputArray backgroundImage) const;
+
+	void getState(std::vector<cv::Mat> & state) const;
+
+	bool setState(const std::vector<cv::Mat> & state, cv::Size size, int type);
+
+	void setAmplification(int n) { m_n = n; }
+
+private:
+	/// Median and variance estimates, CV_8UC(channels)
+	cv::Mat m_median, m_variance;
+	int m_n;
+};
+
+} //: namespace BackgroundEstimator
+} //: namespace Processors
+
+#endif /* FASTSUBTRACTORS_HPP_ */
@@ -0,0 +1,121 @@
+/*!
+ * \file
+ * \brief Binary snapshot of background model
+ * \author Maciej Stefańczyk
+ */
+
+#include "Snapshot.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace Processors {
+namespace BackgroundEstimator {
+
+namespace {
+
+const char magic[4] = { 'D', 'C', 'B', 'G' };
+const int version = 1;
+
+/// Sanity limit for stored strings and matrices count
+const int max_count = 1024;
+
+template <typename T>
+void writePod(std::ostream & os, const T & v) {
+	os.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <typename T>
+bool readPod(std::istream & is, T & v) {
+	return (bool) is.read(reinterpret_cast<char *>(&v), sizeof(T));
+}
+
+void writeString(std::ostream & os, const std::string & s) {
+	writePod<int>(os, s.size());
+	os.write(s.data(), s.size());
+}
+
+bool readString(std::istream & is, std::string & s) {
+	int n;
+	if (!readPod(is, n) || n < 0 || n > max_count)
+		return false;
+	s.resize(n);
+	return n == 0 || (bool) is.read(&s[0], n);
+}
+
+} //: namespace
+
+bool Snapshot::save(const std::string & file) const {
+	std::string tmp = file + ".tmp";
+	{
+		std::ofstream os(tmp.c_str(), std::ios::binary | std::ios::trunc);
+		if (!os)
+			return false;
+
+		os.write(magic, sizeof(magic));
+		writePod(os, version);
+		writeString(os, method);
+		writeString(os, camera);
+		writePod<int>(os, mats.size());
+		for (size_t i = 0; i < mats.size(); ++i) {
+			const cv::Mat & m = mats[i];
+			writePod(os, m.rows);
+			writePod(os, m.cols);
+			writePod(os, m.type());
+			size_t row = m.cols * m.elemSize();
+			for (int y = 0; y < m.rows; ++y)
+				os.write(m.ptr<char>(y), row);
+		}
+
+		if (!os)
+			return false;
+	}
+	return std::rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+bool Snapshot::load(const std::string & file) {
+	std::ifstream is(file.c_str(), std::ios::binary);
+	if (!is)
+		return false;
+
+	// matrix sizes are checked against what is left in the file before anything is allocated
+	is.seekg(0, std::ios::end);
+	std::streamoff size = is.tellg();
+	is.seekg(0, std::ios::beg);
+	if (size < 0 || !is)
+		return false;
+
+	char m[4];
+	int v, count;
+	if (!is.read(m, sizeof(m)) || !std::equal(m, m + 4, magic))
+		return false;
+	if (!readPod(is, v) || v != version)
+		return false;
+	if (!readString(is, method) || !readString(is, camera))
+		return false;
+	if (!readPod(is, count) || count < 0 || count > max_count)
+		return false;
+
+	mats.resize(count);
+	for (int i = 0; i < count; ++i) {
+		int rows, cols, type;
+		if (!readPod(is, rows) || !readPod(is, cols) || !readPod(is, type))
+			return false;
+		if (rows < 0 || cols < 0 || (type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(type) > CV_64F)
+			return false;
+		// background and model states are images, with at most 4 channels
+		if (CV_MAT_CN(type) < 1 || CV_MAT_CN(type) > 4)
+			return false;
+		double bytes = (double) rows * cols * CV_ELEM_SIZE(type);
+		if (bytes > (double) (size - (std::streamoff) is.tellg()))
+			return false;
+		mats[i].create(rows, cols, type);
+		if (!is.read(mats[i].ptr<char>(), mats[i].total() * mats[i].elemSize()))
+			return false;
+	}
+	return true;
+}
+
+} //: namespace BackgroundEstimator
+} //: namespace Processors
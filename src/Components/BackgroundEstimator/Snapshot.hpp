@@ -0,0 +1,54 @@
+/*!
+ * \file
+ * \brief Binary snapshot of background model
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef SNAPSHOT_HPP_
+#define SNAPSHOT_HPP_
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace Processors {
+namespace BackgroundEstimator {
+
+/*!
+ * \class Snapshot
+ * \brief Background model state stored between runs.
+ *
+ * File starts with magic and version, followed by method name, camera
+ * identifier and list of matrices (dimensions, type and raw data). First
+ * matrix is always 8-bit background image, which can seed any method. Methods
+ * with accessible state may append their exact state after it.
+ */
+struct Snapshot {
+	/// Method which produced the snapshot
+	std::string method;
+
+	/// Identifier of camera observing the scene
+	std::string camera;
+
+	/// Background image followed by method specific state
+	std::vector<cv::Mat> mats;
+
+	/*!
+	 * Writes snapshot to temporary file which is then renamed, so that
+	 * existing snapshot is never left half-written.
+	 * \returns true on success
+	 */
+	bool save(const std::string & file) const;
+
+	/*!
+	 * Reads snapshot from file.
+	 * \returns false if file is missing or malformed
+	 */
+	bool load(const std::string & file);
+};
+
+} //: namespace BackgroundEstimator
+} //: namespace Processors
+
+#endif /* SNAPSHOT_HPP_ */
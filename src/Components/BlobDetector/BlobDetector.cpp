@@ -0,0 +1,144 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+
+#include "BlobDetector.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace BlobDetector {
+
+namespace {
+
+bool largerArea(const Types::Blob & a, const Types::Blob & b) {
+	return a.area() > b.area();
+}
+
+} //: namespace
+
+BlobDetector::BlobDetector(const std::string & name) :
+		Base::Component(name) ,
+		threshold("threshold", 128, "range"),
+		min_area("min_area", 20, "range"),
+		max_area("max_area", 100000, "range"),
+		min_circularity("min_circularity", 50, "range") {
+
+	// default skips shadows (127) marked by MOG2
+	threshold.addConstraint("1");
+	threshold.addConstraint("255");
+	registerProperty(threshold);
+
+	min_area.addConstraint("1");
+	min_area.addConstraint("10000");
+	registerProperty(min_area);
+
+	max_area.addConstraint("1");
+	max_area.addConstraint("1000000");
+	registerProperty(max_area);
+
+	// in percents
+	min_circularity.addConstraint("0");
+	min_circularity.addConstraint("100");
+	registerProperty(min_circularity);
+
+	stamp_seq = 0;
+}
+
+BlobDetector::~BlobDetector() {
+}
+
+void BlobDetector::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_img", &in_img);
+	registerStream("in_roi", &in_roi);
+	registerStream("in_stamp", &in_stamp);
+	registerStream("out_ball", &out_ball);
+	registerStream("out_detection", &out_detection);
+	registerStream("out_balls", &out_balls);
+	// Register handlers
+	registerHandler("onNewImage", boost::bind(&BlobDetector::onNewImage, this));
+	addDependency("onNewImage", &in_img);
+
+}
+
+bool BlobDetector::onInit() {
+
+	return true;
+}
+
+bool BlobDetector::onFinish() {
+	return true;
+}
+
+bool BlobDetector::onStop() {
+	return true;
+}
+
+bool BlobDetector::onStart() {
+	return true;
+}
+
+void BlobDetector::onNewImage() {
+	cv::Mat img = in_img.read();
+	Types::Stamp stamp = Types::Trace::readStamp(in_stamp, stamp_seq);
+
+	if (img.type() != CV_8UC1) {
+		CLOG(LERROR) << "BlobDetector: expected single channel 8-bit mask";
+		return;
+	}
+
+	// optional search region (e.g. Kalman.out_roi), latest one is used
+	while (!in_roi.empty())
+		roi = in_roi.read();
+
+	cv::Rect area = roi & cv::Rect(0, 0, img.cols, img.rows);
+	if (area.area() == 0)
+		area = cv::Rect(0, 0, img.cols, img.rows);
+
+	labeler.reset();
+	for (int y = area.y; y < area.y + area.height; ++y)
+		labeler.pushRow(img.ptr<uchar>(y) + area.x, area.width, y, threshold, area.x);
+	labeler.blobs(blobs);
+
+	std::sort(blobs.begin(), blobs.end(), largerArea);
+
+	std::vector<std::vector<float> > balls;
+	for (size_t i = 0; i < blobs.size(); ++i) {
+		const Types::Blob & b = blobs[i];
+		if (b.area() > max_area)
+			continue;
+		if (b.area() < min_area)
+			break;
+		if (b.circularity() < 0.01f * min_circularity)
+			continue;
+
+		cv::Point2f c = b.centroid();
+		std::vector<float> ball;
+		ball.push_back(c.x);
+		ball.push_back(c.y);
+		ball.push_back(b.radius());
+		balls.push_back(ball);
+	}
+
+	CLOG(LDEBUG) << "Blobs: " << blobs.size() << ", accepted: " << balls.size();
+
+	// single measurement (the largest blob) is published only when something was found,
+	// so that Kalman can count missed detections
+	if (!balls.empty()) {
+		out_ball.write(balls[0]);
+		out_detection.write(Types::Ball::make(balls[0][0], balls[0][1], balls[0][2], stamp.capture, stamp.seq));
+	}
+	out_balls.write(balls);
+}
+
+
+
+} //: namespace BlobDetector
+} //: namespace Processors
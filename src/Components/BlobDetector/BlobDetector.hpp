@@ -0,0 +1,119 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef BLOBDETECTOR_HPP_
+#define BLOBDETECTOR_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include "Types/BlobLabeler.hpp"
+#include "Types/Ball.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+
+
+namespace Processors {
+namespace BlobDetector {
+
+/*!
+ * \class BlobDetector
+ * \brief BlobDetector processor class.
+ *
+ * Finds foreground blobs in a binary mask in single pass (connected component
+ * labelling with moments accumulated on the fly) and publishes ball
+ * measurements [x, y, r] of blobs passing area and circularity filters.
+ */
+class BlobDetector: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	BlobDetector(const std::string & name = "BlobDetector");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~BlobDetector();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<cv::Mat> in_img;
+	Base::DataStreamIn<cv::Rect> in_roi;
+	/// Stamp of the frame on in_img (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
+
+	// Output data streams
+	Base::DataStreamOut<std::vector<float> > out_ball;
+	/// The same ball with capture time and number of the frame, e.g. for Kalman.in_ball
+	Base::DataStreamOut<Types::Ball> out_detection;
+	Base::DataStreamOut<std::vector<std::vector<float> > > out_balls;
+
+	// Handlers
+
+	// Properties
+	Base::Property<int> threshold;
+	Base::Property<int> min_area;
+	Base::Property<int> max_area;
+	Base::Property<int> min_circularity;
+
+
+	// Handlers
+	void onNewImage();
+
+	/// Search region, empty if whole image should be searched
+	cv::Rect roi;
+
+	Types::BlobLabeler labeler;
+	std::vector<Types::Blob> blobs;
+
+	/// Number of the next frame without stamp
+	uint32_t stamp_seq;
+};
+
+} //: namespace BlobDetector
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("BlobDetector", Processors::BlobDetector::BlobDetector)
+
+#endif /* BLOBDETECTOR_HPP_ */
@@ -0,0 +1,188 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+
+#include "ColorBallDetector.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace ColorBallDetector {
+
+ColorBallDetector::ColorBallDetector(const std::string & name) :
+		Base::Component(name) ,
+		hue_low("hue.threshold.low", 0, "range"),
+		hue_high("hue.threshold.high", 180, "range"),
+		saturation_low("saturation.threshold.low", 0, "range"),
+		saturation_high("saturation.threshold.high", 255, "range"),
+		value_low("value.threshold.low", 0, "range"),
+		value_high("value.threshold.high", 255, "range"),
+		open("open", 1, "range"),
+		min_area("min_area", 20, "range"),
+		min_circularity("min_circularity", 50, "range") {
+
+	// hue in OpenCV 8-bit HSV is in range 0..180, low > high wraps around (red)
+	hue_low.addConstraint("0");
+	hue_low.addConstraint("180");
+	registerProperty(hue_low);
+	hue_high.addConstraint("0");
+	hue_high.addConstraint("180");
+	registerProperty(hue_high);
+
+	saturation_low.addConstraint("0");
+	saturation_low.addConstraint("255");
+	registerProperty(saturation_low);
+	saturation_high.addConstraint("0");
+	saturation_high.addConstraint("255");
+	registerProperty(saturation_high);
+
+	value_low.addConstraint("0");
+	value_low.addConstraint("255");
+	registerProperty(value_low);
+	value_high.addConstraint("0");
+	value_high.addConstraint("255");
+	registerProperty(value_high);
+
+	// number of 3x3 opening iterations
+	open.addConstraint("0");
+	open.addConstraint("3");
+	registerProperty(open);
+
+	min_area.addConstraint("1");
+	min_area.addConstraint("10000");
+	registerProperty(min_area);
+
+	// in percents
+	min_circularity.addConstraint("0");
+	min_circularity.addConstraint("100");
+	registerProperty(min_circularity);
+
+	stamp_seq = 0;
+}
+
+ColorBallDetector::~ColorBallDetector() {
+}
+
+void ColorBallDetector::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_img", &in_img);
+	registerStream("in_roi", &in_roi);
+	registerStream("in_stamp", &in_stamp);
+	registerStream("out_ball", &out_ball);
+	registerStream("out_detection", &out_detection);
+	// Register handlers
+	registerHandler("onNewImage", boost::bind(&ColorBallDetector::onNewImage, this));
+	addDependency("onNewImage", &in_img);
+
+}
+
+bool ColorBallDetector::onInit() {
+
+	return true;
+}
+
+bool ColorBallDetector::onFinish() {
+	return true;
+}
+
+bool ColorBallDetector::onStop() {
+	return true;
+}
+
+bool ColorBallDetector::onStart() {
+	return true;
+}
+
+void ColorBallDetector::onNewImage() {
+	cv::Mat img = in_img.read();
+	Types::Stamp stamp = Types::Trace::readStamp(in_stamp, stamp_seq);
+
+	if (img.type() != CV_8UC3) {
+		CLOG(LERROR) << "ColorBallDetector: expected 8-bit BGR image";
+		return;
+	}
+
+	// optional search region (e.g. Kalman.out_roi), latest one is used
+	while (!in_roi.empty())
+		roi = in_roi.read();
+
+	cv::Rect area = roi & cv::Rect(0, 0, img.cols, img.rows);
+	if (area.area() == 0)
+		area = cv::Rect(0, 0, img.cols, img.rows);
+	cv::Mat view = img(area);
+
+	// opening needs its radius of valid rows on both sides of strip
+	int halo = 2 * open;
+	int buf_rows = strip_rows + 2 * halo;
+	hsv_buf.create(buf_rows, img.cols, CV_8UC3);
+	bin_buf.create(buf_rows, img.cols, CV_8UC1);
+	tmp_buf.create(buf_rows, img.cols, CV_8UC1);
+
+	labeler.reset();
+	for (int y0 = 0; y0 < view.rows; y0 += strip_rows) {
+		int y1 = std::min(y0 + strip_rows, view.rows);
+		int a = std::max(0, y0 - halo);
+		int b = std::min(view.rows, y1 + halo);
+
+		// views into preallocated buffers, so nothing is allocated per strip
+		cv::Mat hsv = hsv_buf(cv::Rect(0, 0, view.cols, b - a));
+		cv::Mat bin = bin_buf(cv::Rect(0, 0, view.cols, b - a));
+
+		cv::cvtColor(view.rowRange(a, b), hsv, cv::COLOR_BGR2HSV);
+		threshold(hsv, bin);
+		// isolated border - pixels of the buffer outside of the strip view (rows below the
+		// last strip, columns right of a narrower search region) hold stale data, edges of
+		// the search region are treated like frame edges
+		if (open > 0)
+			cv::morphologyEx(bin, bin, cv::MORPH_OPEN, cv::Mat(), cv::Point(-1, -1), open,
+					cv::BORDER_CONSTANT | cv::BORDER_ISOLATED, cv::morphologyDefaultBorderValue());
+
+		for (int y = y0; y < y1; ++y)
+			labeler.pushRow(bin.ptr<uchar>(y - a), view.cols, y + area.y, 128, area.x);
+	}
+	labeler.blobs(blobs);
+
+	const Types::Blob * best = NULL;
+	for (size_t i = 0; i < blobs.size(); ++i) {
+		const Types::Blob & b = blobs[i];
+		if (b.area() < min_area || b.circularity() < 0.01f * min_circularity)
+			continue;
+		if (!best || b.area() > best->area())
+			best = &b;
+	}
+
+	if (best) {
+		cv::Point2f c = best->centroid();
+		std::vector<float> ball;
+		ball.push_back(c.x);
+		ball.push_back(c.y);
+		ball.push_back(best->radius());
+		out_ball.write(ball);
+		out_detection.write(Types::Ball::make(c.x, c.y, best->radius(), stamp.capture, stamp.seq));
+	}
+}
+
+void ColorBallDetector::threshold(const cv::Mat & hsv, cv::Mat & bin) {
+	if (hue_low <= hue_high) {
+		cv::inRange(hsv, cv::Scalar(hue_low, saturation_low, value_low),
+				cv::Scalar(hue_high, saturation_high, value_high), bin);
+	} else {
+		cv::Mat tmp = tmp_buf(cv::Rect(0, 0, hsv.cols, hsv.rows));
+		cv::inRange(hsv, cv::Scalar(hue_low, saturation_low, value_low),
+				cv::Scalar(255, saturation_high, value_high), bin);
+		cv::inRange(hsv, cv::Scalar(0, saturation_low, value_low),
+				cv::Scalar(hue_high, saturation_high, value_high), tmp);
+		cv::bitwise_or(bin, tmp, bin);
+	}
+}
+
+
+
+} //: namespace ColorBallDetector
+} //: namespace Processors
@@ -0,0 +1,137 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef COLORBALLDETECTOR_HPP_
+#define COLORBALLDETECTOR_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include "Types/BlobLabeler.hpp"
+#include "Types/Ball.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+
+
+namespace Processors {
+namespace ColorBallDetector {
+
+/*!
+ * \class ColorBallDetector
+ * \brief ColorBallDetector processor class.
+ *
+ * Detects ball of given colour directly in BGR image. Colour conversion,
+ * HSV thresholding, morphological opening and blob measurement are done
+ * together, strip by strip, so that intermediate images never leave cache.
+ * Publishes [x, y, r] of the largest blob passing area and circularity filters,
+ * also as Types::Ball stamped with the frame.
+ */
+class ColorBallDetector: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	ColorBallDetector(const std::string & name = "ColorBallDetector");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~ColorBallDetector();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<cv::Mat> in_img;
+	Base::DataStreamIn<cv::Rect> in_roi;
+	/// Stamp of the frame on in_img (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
+
+	// Output data streams
+	Base::DataStreamOut<std::vector<float> > out_ball;
+	/// The same ball with capture time and number of the frame, e.g. for Kalman.in_ball
+	Base::DataStreamOut<Types::Ball> out_detection;
+
+	// Handlers
+
+	// Properties
+	Base::Property<int> hue_low;
+	Base::Property<int> hue_high;
+	Base::Property<int> saturation_low;
+	Base::Property<int> saturation_high;
+	Base::Property<int> value_low;
+	Base::Property<int> value_high;
+	Base::Property<int> open;
+	Base::Property<int> min_area;
+	Base::Property<int> min_circularity;
+
+
+	// Handlers
+	void onNewImage();
+
+	/*!
+	 * Thresholds HSV strip into binary one (255 - in range).
+	 * Hue range wraps around if low threshold is greater than high one.
+	 */
+	void threshold(const cv::Mat & hsv, cv::Mat & bin);
+
+	/// Number of rows processed at once
+	static const int strip_rows = 32;
+
+	// Strip buffers, reused between frames
+	cv::Mat hsv_buf, bin_buf, tmp_buf;
+
+	/// Search region, empty if whole image should be searched
+	cv::Rect roi;
+
+	Types::BlobLabeler labeler;
+	std::vector<Types::Blob> blobs;
+
+	/// Number of the next frame without stamp
+	uint32_t stamp_seq;
+};
+
+} //: namespace ColorBallDetector
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("ColorBallDetector", Processors::ColorBallDetector::ColorBallDetector)
+
+#endif /* COLORBALLDETECTOR_HPP_ */
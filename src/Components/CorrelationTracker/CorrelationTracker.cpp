@@ -0,0 +1,363 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+#include <cmath>
+
+#include "CorrelationTracker.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace CorrelationTracker {
+
+namespace {
+
+/// Regularization of filter denominator
+const float lambda = 1e-2f;
+
+/// Half size of the region around the peak excluded from sidelobe statistics
+const int psr_exclude = 5;
+
+} //: namespace
+
+CorrelationTracker::CorrelationTracker(const std::string & name) :
+		Base::Component(name),
+		template_size("size", 64, "range"),
+		padding("padding", 100, "range"),
+		sigma("sigma", 20, "range"),
+		rate("rate", 125, "range"),
+		scales("scales", 3, "range"),
+		scale_step("scale.step", 50, "range"),
+		min_psr("min_psr", 70, "range"),
+		lost("lost", 10, "range") {
+
+	// side of the template, rounded up to size efficient for DFT
+	template_size.addConstraint("16");
+	template_size.addConstraint("256");
+	registerProperty(template_size);
+
+	// context around the object, in percents of object size on each side
+	padding.addConstraint("0");
+	padding.addConstraint("300");
+	registerProperty(padding);
+
+	// width of desired gaussian response, in tenths of template pixel
+	sigma.addConstraint("5");
+	sigma.addConstraint("100");
+	registerProperty(sigma);
+
+	// learning rate of the filter, in thousandths
+	rate.addConstraint("0");
+	rate.addConstraint("1000");
+	registerProperty(rate);
+
+	// number of scales searched in each frame (1 - no scale adaptation)
+	scales.addConstraint("1");
+	scales.addConstraint("7");
+	registerProperty(scales);
+
+	// ratio between neighbouring scales, in thousandths above 1
+	scale_step.addConstraint("1");
+	scale_step.addConstraint("500");
+	registerProperty(scale_step);
+
+	// peak to sidelobe ratio (in tenths) below which detection is rejected
+	min_psr.addConstraint("0");
+	min_psr.addConstraint("500");
+	registerProperty(min_psr);
+
+	lost.addConstraint("1");
+	lost.addConstraint("500");
+	registerProperty(lost);
+
+	for (int i = 0; i < 256; ++i)
+		log_lut[i] = std::log(1.0f + i);
+
+	n = 0;
+	radius = 0;
+	side = 0;
+	tracking = false;
+	reset_flag = false;
+	lost_counter = 0;
+}
+
+CorrelationTracker::~CorrelationTracker() {
+}
+
+void CorrelationTracker::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_img", &in_img);
+	registerStream("in_seed", &in_seed);
+	registerStream("in_box", &in_box);
+	registerStream("out_ball", &out_ball);
+	// Register handlers
+	registerHandler("onNewImage", boost::bind(&CorrelationTracker::onNewImage, this));
+	addDependency("onNewImage", &in_img);
+	registerHandler("reset", boost::bind(&CorrelationTracker::reset, this));
+
+}
+
+bool CorrelationTracker::onInit() {
+
+	return true;
+}
+
+bool CorrelationTracker::onFinish() {
+	return true;
+}
+
+bool CorrelationTracker::onStop() {
+	return true;
+}
+
+bool CorrelationTracker::onStart() {
+	return true;
+}
+
+void CorrelationTracker::onNewImage() {
+	cv::Mat img = in_img.read();
+	if (img.channels() == 3)
+		cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+	else
+		img.copyTo(gray);
+
+	if (reset_flag) {
+		tracking = false;
+		reset_flag = false;
+	}
+
+	// seeds are used only to (re)initialize tracker, latest one wins
+	cv::Rect seed;
+	while (!in_seed.empty()) {
+		std::vector<float> ball = in_seed.read();
+		if (ball.size() >= 3)
+			seed = cv::Rect(cvRound(ball[0] - ball[2]), cvRound(ball[1] - ball[2]), cvRound(2 * ball[2]), cvRound(2 * ball[2]));
+	}
+	while (!in_box.empty())
+		seed = in_box.read();
+
+	if (!tracking) {
+		if (seed.area() > 0)
+			initialize(gray, seed);
+		return;
+	}
+
+	// search over scales centered at current one (symmetric also for even count)
+	float step = 1 + 0.001f * scale_step;
+	int ns = scales;
+	float best_peak = -1, best_scale = 1;
+	cv::Point2f best_loc;
+	for (int s = 0; s < ns; ++s) {
+		float k = std::pow(step, s - 0.5f * (ns - 1));
+		extract(gray, center, side * k);
+		cv::Point2f loc;
+		float peak = detect(loc);
+		if (peak > best_peak) {
+			best_peak = peak;
+			best_scale = k;
+			best_loc = loc;
+		}
+	}
+
+	// response of the best scale is needed for PSR
+	if (ns > 1) {
+		extract(gray, center, side * best_scale);
+		detect(best_loc);
+	}
+	cv::Point peak(std::min(std::max(cvRound(best_loc.x), 0), n - 1), std::min(std::max(cvRound(best_loc.y), 0), n - 1));
+	float quality = psr(peak);
+
+	if (quality < 0.1f * min_psr) {
+		CLOG(LDEBUG) << "CorrelationTracker: PSR " << quality << " too low";
+		lost_counter++;
+		if (lost_counter >= lost)
+			tracking = false;
+		return;
+	}
+	lost_counter = 0;
+
+	// peak displacement from template center, scaled back to the image
+	float k = side * best_scale / n;
+	center.x += (best_loc.x - n / 2) * k;
+	center.y += (best_loc.y - n / 2) * k;
+	side *= best_scale;
+	radius *= best_scale;
+
+	// update filter with patch at new location
+	extract(gray, center, side);
+	train(0.001f * rate);
+
+	std::vector<float> ball;
+	ball.push_back(center.x);
+	ball.push_back(center.y);
+	ball.push_back(radius);
+	out_ball.write(ball);
+}
+
+void CorrelationTracker::reset() {
+	reset_flag = true;
+}
+
+void CorrelationTracker::initialize(const cv::Mat & frame, const cv::Rect & box) {
+	int size = cv::getOptimalDFTSize(template_size);
+	if (size != n) {
+		n = size;
+
+		cv::createHanningWindow(window, cv::Size(n, n), CV_32F);
+		patch.create(n, n, CV_8U);
+		f.create(n, n, CV_32F);
+		F.create(n, n, CV_32FC2);
+		R.create(n, n, CV_32FC2);
+		resp.create(n, n, CV_32F);
+		A.create(n, n, CV_32FC2);
+		B.create(n, n, CV_32F);
+	}
+
+	// desired response - gaussian peak at template center
+	float s = 0.1f * sigma;
+	cv::Mat g(n, n, CV_32F);
+	for (int y = 0; y < n; ++y) {
+		float * row = g.ptr<float>(y);
+		for (int x = 0; x < n; ++x) {
+			float dx = x - n / 2, dy = y - n / 2;
+			row[x] = std::exp(-0.5f * (dx * dx + dy * dy) / (s * s));
+		}
+	}
+	cv::dft(g, G, cv::DFT_COMPLEX_OUTPUT);
+
+	center = cv::Point2f(box.x + 0.5f * box.width, box.y + 0.5f * box.height);
+	radius = 0.25f * (box.width + box.height);
+	side = 2 * radius * (1 + 0.02f * padding);
+
+	A.setTo(0);
+	B.setTo(0);
+	extract(frame, center, side);
+	train(1);
+
+	tracking = true;
+	lost_counter = 0;
+	CLOG(LDEBUG) << "CorrelationTracker: initialized in " << box;
+}
+
+void CorrelationTracker::extract(const cv::Mat & frame, cv::Point2f c, float s) {
+	// maps window of given side centered at c onto template, borders replicated
+	float k = n / s;
+	cv::Matx23f M(k, 0, n / 2 - k * c.x, 0, k, n / 2 - k * c.y);
+	cv::warpAffine(frame, patch, M, patch.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+
+	// log transform and normalization to zero mean, unit norm
+	double sum = 0, sum2 = 0;
+	for (int y = 0; y < n; ++y) {
+		const uchar * src = patch.ptr<uchar>(y);
+		float * dst = f.ptr<float>(y);
+		for (int x = 0; x < n; ++x) {
+			float v = log_lut[src[x]];
+			dst[x] = v;
+			sum += v;
+			sum2 += v * v;
+		}
+	}
+	float mean = sum / (n * n);
+	float dev = std::sqrt(std::max<float>(sum2 / (n * n) - mean * mean, 0)) + 1e-5f;
+
+	for (int y = 0; y < n; ++y) {
+		float * dst = f.ptr<float>(y);
+		const float * w = window.ptr<float>(y);
+		for (int x = 0; x < n; ++x)
+			dst[x] = (dst[x] - mean) / dev * w[x];
+	}
+
+	cv::dft(f, F, cv::DFT_COMPLEX_OUTPUT);
+}
+
+void CorrelationTracker::train(float eta) {
+	// A = G . conj(F), B = F . conj(F), blended into running model
+	for (int y = 0; y < n; ++y) {
+		const cv::Vec2f * pf = F.ptr<cv::Vec2f>(y);
+		const cv::Vec2f * pg = G.ptr<cv::Vec2f>(y);
+		cv::Vec2f * pa = A.ptr<cv::Vec2f>(y);
+		float * pb = B.ptr<float>(y);
+		for (int x = 0; x < n; ++x) {
+			float fr = pf[x][0], fi = pf[x][1];
+			float gr = pg[x][0], gi = pg[x][1];
+			float ar = gr * fr + gi * fi;
+			float ai = gi * fr - gr * fi;
+			float b = fr * fr + fi * fi;
+			pa[x][0] = (1 - eta) * pa[x][0] + eta * ar;
+			pa[x][1] = (1 - eta) * pa[x][1] + eta * ai;
+			pb[x] = (1 - eta) * pb[x] + eta * b;
+		}
+	}
+}
+
+float CorrelationTracker::detect(cv::Point2f & loc) {
+	// R = F . A / B, denominator is real
+	for (int y = 0; y < n; ++y) {
+		const cv::Vec2f * pf = F.ptr<cv::Vec2f>(y);
+		const cv::Vec2f * pa = A.ptr<cv::Vec2f>(y);
+		const float * pb = B.ptr<float>(y);
+		cv::Vec2f * pr = R.ptr<cv::Vec2f>(y);
+		for (int x = 0; x < n; ++x) {
+			float fr = pf[x][0], fi = pf[x][1];
+			float hr = pa[x][0], hi = pa[x][1];
+			float b = 1.0f / (pb[x] + lambda);
+			pr[x][0] = (fr * hr - fi * hi) * b;
+			pr[x][1] = (fr * hi + fi * hr) * b;
+		}
+	}
+	cv::idft(R, resp, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+	double peak;
+	cv::Point p;
+	cv::minMaxLoc(resp, NULL, &peak, NULL, &p);
+
+	// parabolic subpixel refinement
+	loc = cv::Point2f(p.x, p.y);
+	if (p.x > 0 && p.x < n - 1) {
+		const float * row = resp.ptr<float>(p.y);
+		float d = row[p.x - 1] - 2 * row[p.x] + row[p.x + 1];
+		if (d < 0)
+			loc.x += 0.5f * (row[p.x - 1] - row[p.x + 1]) / d;
+	}
+	if (p.y > 0 && p.y < n - 1) {
+		float u = resp.at<float>(p.y - 1, p.x), c = resp.at<float>(p.y, p.x), l = resp.at<float>(p.y + 1, p.x);
+		float d = u - 2 * c + l;
+		if (d < 0)
+			loc.y += 0.5f * (u - l) / d;
+	}
+
+	return peak;
+}
+
+float CorrelationTracker::psr(cv::Point peak) {
+	double sum = 0, sum2 = 0;
+	int count = 0;
+	for (int y = 0; y < n; ++y) {
+		const float * row = resp.ptr<float>(y);
+		bool near = std::abs(y - peak.y) <= psr_exclude;
+		for (int x = 0; x < n; ++x) {
+			if (near && std::abs(x - peak.x) <= psr_exclude)
+				continue;
+			sum += row[x];
+			sum2 += row[x] * row[x];
+			++count;
+		}
+	}
+	if (count == 0)
+		return 0;
+
+	double mean = sum / count;
+	double dev = std::sqrt(std::max(sum2 / count - mean * mean, 0.0));
+	return (resp.at<float>(peak) - mean) / (dev + 1e-5);
+}
+
+
+
+} //: namespace CorrelationTracker
+} //: namespace Processors
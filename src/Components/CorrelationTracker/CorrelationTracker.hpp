@@ -0,0 +1,155 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef CORRELATIONTRACKER_HPP_
+#define CORRELATIONTRACKER_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+
+namespace Processors {
+namespace CorrelationTracker {
+
+/*!
+ * \class CorrelationTracker
+ * \brief CorrelationTracker processor class.
+ *
+ * MOSSE correlation filter tracker. Object window is resampled to fixed size
+ * template, filter is trained and applied in Fourier domain. Window function,
+ * desired response spectrum and all work buffers are allocated once, when the
+ * tracker is initialized, so frames are processed without allocations.
+ */
+class CorrelationTracker: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	CorrelationTracker(const std::string & name = "CorrelationTracker");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~CorrelationTracker();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<cv::Mat> in_img;
+	Base::DataStreamIn<std::vector<float> > in_seed;
+	Base::DataStreamIn<cv::Rect> in_box;
+
+	// Output data streams
+	Base::DataStreamOut<std::vector<float> > out_ball;
+
+	// Handlers
+
+	// Properties
+	Base::Property<int> template_size;
+	Base::Property<int> padding;
+	Base::Property<int> sigma;
+	Base::Property<int> rate;
+	Base::Property<int> scales;
+	Base::Property<int> scale_step;
+	Base::Property<int> min_psr;
+	Base::Property<int> lost;
+
+
+	// Handlers
+	void onNewImage();
+	void reset();
+
+	/*!
+	 * Allocates buffers and trains initial filter for object in given window.
+	 */
+	void initialize(const cv::Mat & frame, const cv::Rect & box);
+
+	/*!
+	 * Extracts square patch of given side centered at c, normalizes it, applies
+	 * window function and computes its spectrum (in F).
+	 */
+	void extract(const cv::Mat & frame, cv::Point2f c, float s);
+
+	/*!
+	 * Blends filter computed for current spectrum into the model with given rate.
+	 */
+	void train(float eta);
+
+	/*!
+	 * Correlates current spectrum with the filter. Response is left in resp.
+	 * \returns peak value, location of the peak (with subpixel refinement) in loc
+	 */
+	float detect(cv::Point2f & loc);
+
+	/*!
+	 * Peak to sidelobe ratio of current response.
+	 */
+	float psr(cv::Point peak);
+
+	/// Template size
+	int n;
+	/// Window function and log lookup table
+	cv::Mat window;
+	float log_lut[256];
+	/// Spectrum of desired response
+	cv::Mat G;
+	/// Filter numerator (complex) and denominator (real)
+	cv::Mat A, B;
+	/// Work buffers
+	cv::Mat gray, patch, f, F, R, resp;
+
+	/// Object center, radius and window side (in image pixels)
+	cv::Point2f center;
+	float radius;
+	float side;
+
+	bool tracking;
+	bool reset_flag;
+	int lost_counter;
+};
+
+} //: namespace CorrelationTracker
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("CorrelationTracker", Processors::CorrelationTracker::CorrelationTracker)
+
+#endif /* CORRELATIONTRACKER_HPP_ */
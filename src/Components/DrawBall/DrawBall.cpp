@@ -25,6 +25,10 @@ DrawBall::DrawBall(const std::string & name) :
 	color.addConstraint("360");
 	registerProperty(color);
 	registerProperty(decay);
+	
+	has_last = false;
+	trace_stage = -1;
+	stamp_seq = 0;
 }
 
 DrawBall::~DrawBall() {
@@ -33,8 +37,11 @@ DrawBall::~DrawBall() {
 void DrawBall::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_ball", &in_ball);
+	registerStream("in_track", &in_track);
 	registerStream("in_img", &in_img);
+	registerStream("in_stamp", &in_stamp);
 	registerStream("out_img", &out_img);
+	registerStream("out_stamp", &out_stamp);
 	// Register handlers
 	registerHandler("onNewImage", boost::bind(&DrawBall::onNewImage, this));
 	addDependency("onNewImage", &in_img);
@@ -42,7 +49,7 @@ void DrawBall::prepareInterface() {
 }
 
 bool DrawBall::onInit() {
-
+	trace_stage = Types::Trace::stage(name());
 	return true;
 }
 
@@ -59,13 +66,19 @@ bool DrawBall::onStart() {
 }
 
 void DrawBall::onNewImage() {
-	cv::Mat img = in_img.read().clone();
+	cv::Mat in = in_img.read();
+	Types::FrameArena::acquire(out_buf, in.size(), in.type());
+	in.copyTo(out_buf);
+	cv::Mat img = out_buf;
+	Types::Stamp stamp = Types::Trace::readStamp(in_stamp, stamp_seq);
+	Types::Trace::Scope trace(trace_stage, stamp);
 	
-	cv::Mat tmp(1, 1, CV_32FC3);
+	// single pixel conversion on stack data, so it doesn't allocate
 	cv::Point3f hsv(color, 1, 1);
-	tmp.at<cv::Point3f>(0,0) = hsv;
-	cv::cvtColor(tmp, tmp, cv::COLOR_HSV2BGR);
-	cv::Point3f rgb = tmp.at<cv::Point3f>(0,0);
+	cv::Point3f rgb;
+	cv::Mat hsv_px(1, 1, CV_32FC3, &hsv);
+	cv::Mat rgb_px(1, 1, CV_32FC3, &rgb);
+	cv::cvtColor(hsv_px, rgb_px, cv::COLOR_HSV2BGR);
 	cv::Scalar col(255*rgb.x, 255*rgb.y, 255*rgb.z);
 	
 	if (trace_img.empty()) {
@@ -74,11 +87,25 @@ void DrawBall::onNewImage() {
 		trace_img *= (1.0 - 1.0/decay);
 	}
 	
+	bool found = false;
+	cv::Vec3f ball;
 	if (!in_ball.empty()) {
-		std::vector<float> ball = in_ball.read();
+		std::vector<float> b = in_ball.read();
+		if (b.size() >= 3) {
+			ball = cv::Vec3f(b[0], b[1], b[2]);
+			found = true;
+		}
+	}
+	if (!in_track.empty()) {
+		Types::Track t = in_track.read();
+		ball = cv::Vec3f(t.x, t.y, t.r);
+		found = true;
+	}
+	
+	if (found) {
 		cv::Point2f c(ball[0], ball[1]);
 		
-		if (!last_ball.empty()) {
+		if (has_last) {
 			cv::Point2f last_c(last_ball[0], last_ball[1]);
 			cv::line(trace_img, c, last_c, col, 2);
 		}
@@ -86,11 +113,13 @@ void DrawBall::onNewImage() {
 		img += trace_img;
 		cv::circle(img, c, ball[2], col, 2);
 		last_ball = ball;
+		has_last = true;
 	} else {
 		img += trace_img;
-		last_ball.clear();
+		has_last = false;
 	}
 	
+	out_stamp.write(stamp);
 	out_img.write(img);
 }
 
@@ -15,6 +15,11 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "Types/Track.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+#include "Types/FrameArena.hpp"
+
 
 namespace Processors {
 namespace DrawBall {
@@ -69,10 +74,15 @@ protected:
 
 	// Input data streams
 	Base::DataStreamIn<std::vector<float> > in_ball;
+	Base::DataStreamIn<Types::Track> in_track;
 	Base::DataStreamIn<cv::Mat> in_img;
+	/// Stamp of the frame drawn ball comes from (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
 
 	// Output data streams
 	Base::DataStreamOut<cv::Mat> out_img;
+	/// Stamp of the ball on out_img, for end-to-end latency measurement
+	Base::DataStreamOut<Types::Stamp> out_stamp;
 
 	// Handlers
 
@@ -85,7 +95,15 @@ protected:
 	void onNewImage();
 	
 	cv::Mat trace_img;
-	std::vector<float> last_ball;
+	/// Output image buffer, drawn from the frame arena
+	cv::Mat out_buf;
+	/// Last drawn ball [x, y, r]
+	cv::Vec3f last_ball;
+	bool has_last;
+	
+	/// Trace stage id and number of the next frame without stamp
+	int trace_stage;
+	uint32_t stamp_seq;
 };
 
 } //: namespace DrawBall
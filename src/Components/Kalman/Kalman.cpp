@@ -4,6 +4,8 @@
  * \author Maciej Stefańczyk
  */
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <string>
 
@@ -18,10 +20,20 @@ namespace Kalman {
 Kalman::Kalman(const std::string & name) :
 		Base::Component(name),
 		cov_process("cov_process", 100, "range"),
-		cov_measurement("cov_measurement", 10, "range")  {
+		cov_measurement("cov_measurement", 10, "range"),
+		roi_sigma("roi.sigma", 3, "range"),
+		roi_lost("roi.lost", 5, "range"),
+		mode("mode", std::string("sync"), "combo"),
+		lead("lead", 0, "range"),
+		lost_time("lost_time", 1000, "range")  {
 
 	tracking = false;
 	lost_counter = 0;
+	meas_period = 0;
+	track_id = 0;
+	last_stamp = Types::Stamp::make(0, 0);
+	trace_stage = -1;
+	stamp_seq = 0;
 
 	cov_process.addConstraint("1");
 	cov_process.addConstraint("1000");
@@ -30,6 +42,31 @@ Kalman::Kalman(const std::string & name) :
 	cov_measurement.addConstraint("1");
 	cov_measurement.addConstraint("1000");
 	registerProperty(cov_measurement);
+	
+	roi_sigma.addConstraint("1");
+	roi_sigma.addConstraint("10");
+	registerProperty(roi_sigma);
+	
+	// number of missed detections after which full frame search is requested
+	roi_lost.addConstraint("0");
+	roi_lost.addConstraint("50");
+	registerProperty(roi_lost);
+	
+	// sync - predict and correct once per tick, async - correct on measurement
+	// arrival, publish extrapolated state every tick
+	mode.addConstraint("sync");
+	mode.addConstraint("async");
+	registerProperty(mode);
+	
+	// how far ahead (ms) the state is extrapolated in async mode
+	lead.addConstraint("0");
+	lead.addConstraint("1000");
+	registerProperty(lead);
+	
+	// time (ms) without measurement after which track is lost in async mode
+	lost_time.addConstraint("10");
+	lost_time.addConstraint("10000");
+	registerProperty(lost_time);
 
 }
 
@@ -39,10 +76,25 @@ Kalman::~Kalman() {
 void Kalman::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_meas", &in_meas);
+	registerStream("in_ball", &in_ball);
+	registerStream("in_time", &in_time);
+	registerStream("in_stamp", &in_stamp);
 	registerStream("out_pred", &out_pred);
+	registerStream("out_track", &out_track);
+	registerStream("out_roi", &out_roi);
+	registerStream("out_stamp", &out_stamp);
 	// Register handlers
-	registerHandler("update", boost::bind(&Kalman::update, this));
-	addDependency("update", NULL);
+	if (mode == "async") {
+		registerHandler("onMeasurement", boost::bind(&Kalman::onMeasurement, this));
+		addDependency("onMeasurement", &in_meas);
+		registerHandler("onBall", boost::bind(&Kalman::onMeasurement, this));
+		addDependency("onBall", &in_ball);
+		registerHandler("update", boost::bind(&Kalman::extrapolate, this));
+		addDependency("update", NULL);
+	} else {
+		registerHandler("update", boost::bind(&Kalman::update, this));
+		addDependency("update", NULL);
+	}
 
 }
 
@@ -92,6 +144,7 @@ bool Kalman::onInit() {
 	// Measures Noise Covariance Matrix R
 	cv::setIdentity(kf->measurementNoiseCov, cv::Scalar(1e-1));
 	
+	trace_stage = Types::Trace::stage(name());
 	
 	return true;
 }
@@ -105,6 +158,7 @@ bool Kalman::onStop() {
 }
 
 bool Kalman::onStart() {
+	prev_ticks = (double) cv::getTickCount();
 	return true;
 }
 
@@ -112,16 +166,7 @@ void Kalman::update() {
 	double ticks = (double) cv::getTickCount();
 	double dT = (ticks - prev_ticks) / cv::getTickFrequency(); //seconds
 
-	// Process Noise Covariance Matrix Q
-	// [ Ex 0  0    0    0  ]
-	// [ 0  Ey 0    0    0  ]
-	// [ 0  0  Ev_x 0    0  ]
-	// [ 0  0  0    Ev_y 0  ]
-	// [ 0  0  0    0    Er ]
-	cv::setIdentity(kf->processNoiseCov, cv::Scalar(1e-3 * cov_process));
-
-	// Measures Noise Covariance Matrix R
-	cv::setIdentity(kf->measurementNoiseCov, cv::Scalar(1e-3 * cov_measurement));
+	setNoise();
 
 	// Kalman PREDICT
 	if (tracking)
@@ -136,14 +181,12 @@ void Kalman::update() {
 		state = kf->predict();
 		CLOG(LINFO) << "State post: " << std::endl << state;
 		 
-		std::vector<float> out;
-		out.push_back(state.at<float>(0, 0));
-		out.push_back(state.at<float>(0, 1));
-		out.push_back(state.at<float>(0, 4));
-		out_pred.write(out);
+		publishPrediction(state.at<float>(0), state.at<float>(1), state.at<float>(2), state.at<float>(3),
+				state.at<float>(4), ticks / cv::getTickFrequency());
 	}       
 	
-	if (in_meas.empty())
+	cv::Point3f z;
+	if (!readMeasurement(z))
 	{
 		lost_counter++;
 		CLOG(LDEBUG) << "lost_counter: " << lost_counter;
@@ -158,46 +201,195 @@ void Kalman::update() {
 	}
 	else
 	{
-		std::vector<float> meas_v;
-		while(!in_meas.empty())
-			meas_v = in_meas.read();
 		lost_counter = 0;
 
-		meas.at<float>(0) = meas_v[0];
-		meas.at<float>(1) = meas_v[1];
-		meas.at<float>(2) = meas_v[2];
+		correct(z);
+		if (Types::Trace::enabled())
+			Types::Trace::record(trace_stage, last_stamp, ticks / cv::getTickFrequency(), Types::Trace::now());
+	}
+	prev_ticks = ticks;
+	// <<<<< Kalman Update
+	
+	// next frame is expected after the same interval
+	publishRoi(dT);
+}
 
-		CLOG(LDEBUG) << "Measure matrix: " << std::endl << meas;
+bool Kalman::readMeasurement(cv::Point3f & z) {
+	bool found = false;
+	while (!in_meas.empty()) {
+		std::vector<float> meas_v = in_meas.read();
+		if (meas_v.size() < 3)
+			continue;
+		z = cv::Point3f(meas_v[0], meas_v[1], meas_v[2]);
+		found = true;
+	}
+	double ball_time = 0;
+	while (!in_ball.empty()) {
+		Types::Ball ball = in_ball.read();
+		z = cv::Point3f(ball.x, ball.y, ball.r);
+		ball_time = ball.timestamp;
+		found = true;
+	}
+	
+	// stamp stream takes precedence, then timestamp carried by the ball; ball id
+	// depends on the producer, so frames without stamp are numbered locally
+	if (found) {
+		bool stamped = !in_stamp.empty();
+		last_stamp = Types::Trace::readStamp(in_stamp, stamp_seq);
+		if (!stamped && ball_time > 0)
+			last_stamp.capture = ball_time;
+	}
+	return found;
+}
+
+void Kalman::correct(const cv::Point3f & z) {
+	meas.at<float>(0) = z.x;
+	meas.at<float>(1) = z.y;
+	meas.at<float>(2) = z.z;
+
+	CLOG(LDEBUG) << "Measure matrix: " << std::endl << meas;
+	
+	if (!tracking) // First detection!
+	{
+		CLOG(LDEBUG) << "Initialize: errorCovPre.size() = " << kf->errorCovPre.size();
+		// >>>> Initialization
+		kf->errorCovPre.at<float>(0) = 1; // px
+		kf->errorCovPre.at<float>(6) = 1; // px
+		kf->errorCovPre.at<float>(12) = 1;
+		kf->errorCovPre.at<float>(18) = 1;
+		kf->errorCovPre.at<float>(24) = 1; // px
+
+		CLOG(LDEBUG) << "state.size()=" << state.size();
+		state.at<float>(0) = meas.at<float>(0);
+		state.at<float>(1) = meas.at<float>(1);
+		state.at<float>(2) = 0;
+		state.at<float>(3) = 0;
+		state.at<float>(4) = meas.at<float>(2);
+		// <<<< Initialization
 		
-		if (!tracking) // First detection!
-		{
-			CLOG(LDEBUG) << "Initialize: errorCovPre.size() = " << kf->errorCovPre.size();
-			// >>>> Initialization
-			kf->errorCovPre.at<float>(0) = 1; // px
-			kf->errorCovPre.at<float>(6) = 1; // px
-			kf->errorCovPre.at<float>(12) = 1;
-			kf->errorCovPre.at<float>(18) = 1;
-			kf->errorCovPre.at<float>(24) = 1; // px
-
-			CLOG(LDEBUG) << "state.size()=" << state.size();
-			state.at<float>(0) = meas.at<float>(0);
-			state.at<float>(1) = meas.at<float>(1);
-			state.at<float>(2) = 0;
-			state.at<float>(3) = 0;
-			state.at<float>(4) = meas.at<float>(2);
-			// <<<< Initialization
-			
-			kf->statePost = state;
-			kf->errorCovPost = kf->errorCovPre;
+		kf->statePost = state;
+		kf->errorCovPost = kf->errorCovPre;
 
-			tracking = true;
-		} else {
-			kf->correct(meas); // Kalman CORRECTION
-		}
+		tracking = true;
+		track_id++;
+	} else {
+		kf->correct(meas); // Kalman CORRECTION
+	}
+}
 
+void Kalman::setNoise() {
+	// Process Noise Covariance Matrix Q
+	// [ Ex 0  0    0    0  ]
+	// [ 0  Ey 0    0    0  ]
+	// [ 0  0  Ev_x 0    0  ]
+	// [ 0  0  0    Ev_y 0  ]
+	// [ 0  0  0    0    Er ]
+	cv::setIdentity(kf->processNoiseCov, cv::Scalar(1e-3 * cov_process));
+
+	// Measures Noise Covariance Matrix R
+	cv::setIdentity(kf->measurementNoiseCov, cv::Scalar(1e-3 * cov_measurement));
+}
+
+void Kalman::onMeasurement() {
+	double ticks = (double) cv::getTickCount();
+	
+	cv::Point3f z;
+	if (!readMeasurement(z))
+		return;
+	
+	setNoise();
+	
+	// predict exactly to the moment of measurement arrival, then correct
+	if (tracking) {
+		double dT = (ticks - prev_ticks) / cv::getTickFrequency(); //seconds
+		kf->transitionMatrix.at<float>(2) = dT;
+		kf->transitionMatrix.at<float>(8) = dT;
+		state = kf->predict();
 	}
+	
+	// measurement period is estimated, so that missed measurements can be counted between them
+	double period = (ticks - prev_ticks) / cv::getTickFrequency();
+	if (tracking && period > 0)
+		meas_period = meas_period > 0 ? 0.8 * meas_period + 0.2 * period : period;
+	
+	correct(z);
+	lost_counter = 0;
 	prev_ticks = ticks;
-	// <<<<< Kalman Update
+	
+	if (Types::Trace::enabled())
+		Types::Trace::record(trace_stage, last_stamp, ticks / cv::getTickFrequency(), Types::Trace::now());
+}
+
+void Kalman::extrapolate() {
+	double ticks = (double) cv::getTickCount();
+	double now = ticks / cv::getTickFrequency();
+	double last = prev_ticks / cv::getTickFrequency();
+	
+	if (tracking && now - last > 1e-3 * lost_time) {
+		CLOG(LDEBUG) << "No measurement for " << now - last << "s, track lost";
+		tracking = false;
+		meas_period = 0;
+	}
+	
+	// measurements expected (with half period margin) but not received since the last one
+	lost_counter = meas_period > 0 ? std::max(0, (int) std::floor((now - last) / meas_period - 0.5)) : 0;
+	
+	// requested time, or current time shifted by configured lead
+	double target = now + 1e-3 * lead;
+	while (!in_time.empty())
+		target = in_time.read();
+	
+	// filter itself is not modified, state is only extrapolated
+	float dt = target - last;
+	if (tracking) {
+		const cv::Mat & x = kf->statePost;
+		publishPrediction(x.at<float>(0) + dt * x.at<float>(2), x.at<float>(1) + dt * x.at<float>(3),
+				x.at<float>(2), x.at<float>(3), x.at<float>(4), target);
+	}
+	
+	publishRoi(dt);
+}
+
+void Kalman::publishPrediction(float x, float y, float vx, float vy, float r, double timestamp) {
+	out_stamp.write(last_stamp);
+	
+	std::vector<float> out;
+	out.push_back(x);
+	out.push_back(y);
+	out.push_back(r);
+	out_pred.write(out);
+	
+	Types::Track track;
+	track.timestamp = timestamp;
+	track.id = track_id;
+	track.lost = lost_counter;
+	track.x = x;
+	track.y = y;
+	track.r = r;
+	track.vx = vx;
+	track.vy = vy;
+	out_track.write(track);
+}
+
+void Kalman::publishRoi(float dt) {
+	if (!tracking || lost_counter >= roi_lost) {
+		out_roi.write(cv::Rect());
+		return;
+	}
+	
+	// state and covariance propagated by dt from the last correction
+	cv::Mat A = cv::Mat::eye(kf->transitionMatrix.size(), kf->transitionMatrix.type());
+	A.at<float>(0, 2) = dt;
+	A.at<float>(1, 3) = dt;
+	cv::Mat x = A * kf->statePost;
+	cv::Mat P = A * kf->errorCovPost * A.t() + kf->processNoiseCov;
+	
+	// n-sigma gate on position, extended by (n-sigma upper bound of) radius
+	float r = x.at<float>(4) + roi_sigma * std::sqrt(P.at<float>(4, 4));
+	float w = roi_sigma * std::sqrt(P.at<float>(0, 0)) + r;
+	float h = roi_sigma * std::sqrt(P.at<float>(1, 1)) + r;
+	
+	out_roi.write(cv::Rect(cvFloor(x.at<float>(0) - w), cvFloor(x.at<float>(1) - h), cvCeil(2 * w), cvCeil(2 * h)));
 }
 
 
@@ -15,6 +15,11 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "Types/Ball.hpp"
+#include "Types/Track.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+
 namespace Processors {
 namespace Kalman {
 
@@ -68,26 +73,87 @@ protected:
 
 	// Input data streams
 	Base::DataStreamIn<std::vector<float> > in_meas;
+	Base::DataStreamIn<Types::Ball> in_ball;
+	/// Time (seconds, cv::getTickCount() / cv::getTickFrequency()) for which prediction is requested
+	Base::DataStreamIn<double> in_time;
+	/// Stamp of the frame measurement was taken from (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
 
 	// Output data streams
 	Base::DataStreamOut<std::vector<float> > out_pred;
+	Base::DataStreamOut<Types::Track> out_track;
+	Base::DataStreamOut<cv::Rect> out_roi;
+	/// Stamp of the newest measurement prediction is based on
+	Base::DataStreamOut<Types::Stamp> out_stamp;
 
 	// Handlers
 
 	// Properties
 	Base::Property<int> cov_process;
 	Base::Property<int> cov_measurement;
+	Base::Property<int> roi_sigma;
+	Base::Property<int> roi_lost;
+	Base::Property<std::string> mode;
+	Base::Property<int> lead;
+	Base::Property<int> lost_time;
 
 	
 	// Handlers
 	void update();
+	
+	/*!
+	 * Async mode: corrects filter as soon as measurement arrives.
+	 */
+	void onMeasurement();
+	
+	/*!
+	 * Async mode: publishes state extrapolated to requested time.
+	 */
+	void extrapolate();
+	
+	/*!
+	 * Reads newest measurement from any of measurement streams.
+	 * \returns false if there was no (valid) measurement
+	 */
+	bool readMeasurement(cv::Point3f & z);
+	
+	/*!
+	 * Initializes filter with first measurement or corrects it.
+	 */
+	void correct(const cv::Point3f & z);
+	
+	/*!
+	 * Publishes predicted state [x, y, v_x, v_y, r] on output streams.
+	 */
+	void publishPrediction(float x, float y, float vx, float vy, float r, double timestamp);
+	
+	/*!
+	 * Sets noise covariances from properties.
+	 */
+	void setNoise();
+	
+	/*!
+	 * Publishes region, where ball is expected dt seconds after the last correction.
+	 * Empty region means that the whole frame should be searched.
+	 */
+	void publishRoi(float dt);
 
 	cv::KalmanFilter * kf;
 	cv::Mat state, meas;
 	
 	bool tracking;
 	int lost_counter;
+	/// Async mode: estimated interval between measurements (seconds), 0 - unknown
+	double meas_period;
+	/// Identifier of current track, incremented on each initialization
+	uint32_t track_id;
 	double prev_ticks;
+	
+	/// Stamp of the newest measurement
+	Types::Stamp last_stamp;
+	/// Trace stage id and number of the next measurement without stamp
+	int trace_stage;
+	uint32_t stamp_seq;
 };
 
 } //: namespace Kalman
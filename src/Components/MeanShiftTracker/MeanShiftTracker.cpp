@@ -0,0 +1,195 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+
+#include "MeanShiftTracker.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace MeanShiftTracker {
+
+MeanShiftTracker::MeanShiftTracker(const std::string & name) :
+		Base::Component(name) ,
+		bins("bins", 16, "range"),
+		margin("margin", 50, "range"),
+		saturation_min("saturation.min", 60, "range"),
+		value_min("value.min", 32, "range"),
+		value_max("value.max", 255, "range"),
+		min_score("min_score", 10, "range"),
+		camshift("camshift", true) {
+
+	bins.addConstraint("4");
+	bins.addConstraint("180");
+	registerProperty(bins);
+
+	// search window enlargement, in percents of object window size on each side
+	margin.addConstraint("10");
+	margin.addConstraint("300");
+	registerProperty(margin);
+
+	// pixels with too low saturation or brightness have unreliable hue
+	saturation_min.addConstraint("0");
+	saturation_min.addConstraint("255");
+	registerProperty(saturation_min);
+	value_min.addConstraint("0");
+	value_min.addConstraint("255");
+	registerProperty(value_min);
+	value_max.addConstraint("0");
+	value_max.addConstraint("255");
+	registerProperty(value_max);
+
+	// mean back-projection (in percents) in object window, below which object is lost
+	min_score.addConstraint("0");
+	min_score.addConstraint("100");
+	registerProperty(min_score);
+
+	registerProperty(camshift);
+
+	reset_flag = false;
+}
+
+MeanShiftTracker::~MeanShiftTracker() {
+}
+
+void MeanShiftTracker::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_img", &in_img);
+	registerStream("in_seed", &in_seed);
+	registerStream("in_box", &in_box);
+	registerStream("out_ball", &out_ball);
+	// Register handlers
+	registerHandler("onNewImage", boost::bind(&MeanShiftTracker::onNewImage, this));
+	addDependency("onNewImage", &in_img);
+	registerHandler("reset", boost::bind(&MeanShiftTracker::reset, this));
+
+}
+
+bool MeanShiftTracker::onInit() {
+
+	return true;
+}
+
+bool MeanShiftTracker::onFinish() {
+	return true;
+}
+
+bool MeanShiftTracker::onStop() {
+	return true;
+}
+
+bool MeanShiftTracker::onStart() {
+	return true;
+}
+
+void MeanShiftTracker::onNewImage() {
+	cv::Mat img = in_img.read();
+	cv::Rect frame(0, 0, img.cols, img.rows);
+
+	if (reset_flag) {
+		hist.release();
+		reset_flag = false;
+	}
+
+	// seeds are used only to (re)initialize model, latest one wins
+	cv::Rect seed;
+	while (!in_seed.empty()) {
+		std::vector<float> ball = in_seed.read();
+		if (ball.size() >= 3)
+			seed = cv::Rect(cvRound(ball[0] - ball[2]), cvRound(ball[1] - ball[2]), cvRound(2 * ball[2]), cvRound(2 * ball[2]));
+	}
+	while (!in_box.empty())
+		seed = in_box.read();
+
+	if (hist.empty() && (seed & frame).area() > 0)
+		initModel(img, seed & frame);
+
+	if (hist.empty())
+		return;
+
+	// back-projection is computed only in search region around last position
+	int mx = window.width * margin / 100, my = window.height * margin / 100;
+	cv::Rect search = cv::Rect(window.x - mx, window.y - my, window.width + 2 * mx, window.height + 2 * my) & frame;
+	if (search.area() == 0) {
+		hist.release();
+		return;
+	}
+
+	prepareRegion(img, search);
+	int channels[] = { 0 };
+	float hranges[] = { 0, 180 };
+	const float * ranges[] = { hranges };
+	cv::calcBackProject(&hsv, 1, channels, hist, backproj, ranges);
+	backproj &= mask;
+
+	cv::Rect local = (window - search.tl()) & cv::Rect(0, 0, search.width, search.height);
+	if (local.area() == 0) {
+		hist.release();
+		return;
+	}
+
+	cv::TermCriteria criteria(cv::TermCriteria::EPS | cv::TermCriteria::COUNT, 10, 1);
+	float r;
+	if (camshift) {
+		cv::RotatedRect box = cv::CamShift(backproj, local, criteria);
+		r = 0.25f * (box.size.width + box.size.height);
+	} else {
+		cv::meanShift(backproj, local, criteria);
+		r = 0.25f * (local.width + local.height);
+	}
+
+	if (local.area() == 0) {
+		CLOG(LDEBUG) << "MeanShiftTracker: window collapsed, object lost";
+		hist.release();
+		return;
+	}
+
+	double score = cv::mean(backproj(local))[0] / 255;
+	if (score < 0.01 * min_score) {
+		CLOG(LDEBUG) << "MeanShiftTracker: score " << score << ", object lost";
+		hist.release();
+		return;
+	}
+
+	window = local + search.tl();
+
+	std::vector<float> ball;
+	ball.push_back(window.x + 0.5f * window.width);
+	ball.push_back(window.y + 0.5f * window.height);
+	ball.push_back(r);
+	out_ball.write(ball);
+}
+
+void MeanShiftTracker::reset() {
+	reset_flag = true;
+}
+
+void MeanShiftTracker::prepareRegion(const cv::Mat & img, const cv::Rect & region) {
+	cv::cvtColor(img(region), hsv, cv::COLOR_BGR2HSV);
+	cv::inRange(hsv, cv::Scalar(0, saturation_min, value_min), cv::Scalar(180, 256, value_max), mask);
+}
+
+void MeanShiftTracker::initModel(const cv::Mat & img, const cv::Rect & box) {
+	prepareRegion(img, box);
+
+	int channels[] = { 0 };
+	int size[] = { bins };
+	float hranges[] = { 0, 180 };
+	const float * ranges[] = { hranges };
+	cv::calcHist(&hsv, 1, channels, mask, hist, 1, size, ranges);
+	cv::normalize(hist, hist, 0, 255, cv::NORM_MINMAX);
+
+	window = box;
+	CLOG(LDEBUG) << "MeanShiftTracker: model initialized in " << box;
+}
+
+
+
+} //: namespace MeanShiftTracker
+} //: namespace Processors
@@ -0,0 +1,127 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef MEANSHIFTTRACKER_HPP_
+#define MEANSHIFTTRACKER_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+
+namespace Processors {
+namespace MeanShiftTracker {
+
+/*!
+ * \class MeanShiftTracker
+ * \brief MeanShiftTracker processor class.
+ *
+ * Appearance based tracker. Hue histogram of the object is learned from seed
+ * (ball measurement or box), then object is followed with mean-shift/CamShift
+ * on histogram back-projection. Back-projection is computed only in a search
+ * window around previous location, so cost depends on object size, not on
+ * frame size.
+ */
+class MeanShiftTracker: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	MeanShiftTracker(const std::string & name = "MeanShiftTracker");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~MeanShiftTracker();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<cv::Mat> in_img;
+	Base::DataStreamIn<std::vector<float> > in_seed;
+	Base::DataStreamIn<cv::Rect> in_box;
+
+	// Output data streams
+	Base::DataStreamOut<std::vector<float> > out_ball;
+
+	// Handlers
+
+	// Properties
+	Base::Property<int> bins;
+	Base::Property<int> margin;
+	Base::Property<int> saturation_min;
+	Base::Property<int> value_min;
+	Base::Property<int> value_max;
+	Base::Property<int> min_score;
+	Base::Property<bool> camshift;
+
+
+	// Handlers
+	void onNewImage();
+	void reset();
+
+	/*!
+	 * Converts region of image to HSV and computes mask of pixels with reliable hue.
+	 */
+	void prepareRegion(const cv::Mat & img, const cv::Rect & region);
+
+	/*!
+	 * Learns hue histogram of the object in given window.
+	 */
+	void initModel(const cv::Mat & img, const cv::Rect & box);
+
+	/// Object hue histogram, empty if there is no model
+	cv::Mat hist;
+	/// Current object window
+	cv::Rect window;
+
+	// Buffers for search region
+	cv::Mat hsv, mask, backproj;
+
+	bool reset_flag;
+};
+
+} //: namespace MeanShiftTracker
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("MeanShiftTracker", Processors::MeanShiftTracker::MeanShiftTracker)
+
+#endif /* MEANSHIFTTRACKER_HPP_ */
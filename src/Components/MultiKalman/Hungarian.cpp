@@ -0,0 +1,95 @@
+/*!
+ * \file
+ * \brief Hungarian algorithm for rectangular assignment problems
+ * \author Maciej Stefańczyk
+ */
+
+#include "Hungarian.hpp"
+
+#include <limits>
+
+namespace Processors {
+namespace MultiKalman {
+
+double Hungarian::solve(const std::vector<double> & cost, int rows, int cols, std::vector<int> & assignment) {
+	assignment.assign(rows, -1);
+	if (rows == 0 || cols == 0)
+		return 0;
+
+	// algorithm requires no more rows than columns
+	if (rows <= cols)
+		return solveWide(cost, rows, cols, false, assignment);
+	else
+		return solveWide(cost, cols, rows, true, assignment);
+}
+
+double Hungarian::solveWide(const std::vector<double> & cost, int n, int m, bool transposed, std::vector<int> & assignment) {
+	const double inf = std::numeric_limits<double>::infinity();
+
+	u.assign(n + 1, 0);
+	v.assign(m + 1, 0);
+	p.assign(m + 1, 0);
+	way.assign(m + 1, 0);
+
+	// indices are 1-based, column 0 is a virtual one used to start augmenting paths
+	for (int i = 1; i <= n; ++i) {
+		p[0] = i;
+		int j0 = 0;
+		minv.assign(m + 1, inf);
+		used.assign(m + 1, 0);
+
+		do {
+			used[j0] = 1;
+			int i0 = p[j0], j1 = 0;
+			double delta = inf;
+			for (int j = 1; j <= m; ++j) {
+				if (used[j])
+					continue;
+				double c = transposed ? cost[(j - 1) * n + (i0 - 1)] : cost[(i0 - 1) * m + (j - 1)];
+				double cur = c - u[i0] - v[j];
+				if (cur < minv[j]) {
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if (minv[j] < delta) {
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= m; ++j) {
+				if (used[j]) {
+					u[p[j]] += delta;
+					v[j] -= delta;
+				} else {
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (p[j0] != 0);
+
+		// reverse the augmenting path
+		do {
+			int j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0);
+	}
+
+	double total = 0;
+	for (int j = 1; j <= m; ++j) {
+		if (p[j] == 0)
+			continue;
+		int row = p[j] - 1, col = j - 1;
+		if (transposed) {
+			assignment[col] = row;
+			total += cost[col * n + row];
+		} else {
+			assignment[row] = col;
+			total += cost[row * m + col];
+		}
+	}
+	return total;
+}
+
+} //: namespace MultiKalman
+} //: namespace Processors
@@ -0,0 +1,42 @@
+/*!
+ * \file
+ * \brief Hungarian algorithm for rectangular assignment problems
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef HUNGARIAN_HPP_
+#define HUNGARIAN_HPP_
+
+#include <vector>
+
+namespace Processors {
+namespace MultiKalman {
+
+/*!
+ * \class Hungarian
+ * \brief Minimal cost assignment solver (shortest augmenting path, O(n^2 m)).
+ *
+ * Working memory is kept between calls, so solving many small problems
+ * in a row does not allocate after the first few frames.
+ */
+class Hungarian {
+public:
+	/*!
+	 * Solves assignment for row-major cost matrix with given number of rows and cols.
+	 * \param assignment for each row index of assigned column (or -1 if there are more rows than columns)
+	 * \returns total cost of assignment
+	 */
+	double solve(const std::vector<double> & cost, int rows, int cols, std::vector<int> & assignment);
+
+private:
+	double solveWide(const std::vector<double> & cost, int n, int m, bool transposed, std::vector<int> & assignment);
+
+	std::vector<double> u, v, minv;
+	std::vector<int> p, way;
+	std::vector<char> used;
+};
+
+} //: namespace MultiKalman
+} //: namespace Processors
+
+#endif /* HUNGARIAN_HPP_ */
@@ -0,0 +1,111 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+
+#include "MultiKalman.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace MultiKalman {
+
+MultiKalman::MultiKalman(const std::string & name) :
+		Base::Component(name),
+		cov_process("cov_process", 100, "range"),
+		cov_measurement("cov_measurement", 10, "range"),
+		gate("gate", 50, "range"),
+		lost("lost", 50, "range")  {
+
+	cov_process.addConstraint("1");
+	cov_process.addConstraint("1000");
+	registerProperty(cov_process);
+
+	cov_measurement.addConstraint("1");
+	cov_measurement.addConstraint("1000");
+	registerProperty(cov_measurement);
+
+	// maximal distance (in pixels) between predicted track and its detection
+	gate.addConstraint("1");
+	gate.addConstraint("500");
+	registerProperty(gate);
+
+	// number of consecutive missed detections after which track is removed
+	lost.addConstraint("1");
+	lost.addConstraint("500");
+	registerProperty(lost);
+
+	prev_ticks = 0;
+}
+
+MultiKalman::~MultiKalman() {
+}
+
+void MultiKalman::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_meas", &in_meas);
+	registerStream("out_pred", &out_pred);
+	// Register handlers
+	registerHandler("update", boost::bind(&MultiKalman::update, this));
+	addDependency("update", NULL);
+
+}
+
+bool MultiKalman::onInit() {
+
+	return true;
+}
+
+bool MultiKalman::onFinish() {
+	return true;
+}
+
+bool MultiKalman::onStop() {
+	return true;
+}
+
+bool MultiKalman::onStart() {
+	prev_ticks = (double) cv::getTickCount();
+	return true;
+}
+
+void MultiKalman::update() {
+	double ticks = (double) cv::getTickCount();
+	double dT = (ticks - prev_ticks) / cv::getTickFrequency(); //seconds
+	prev_ticks = ticks;
+
+	tracker.configure(1e-3 * cov_process, 1e-3 * cov_measurement, gate, lost);
+
+	// Kalman PREDICT
+	tracker.predict(dT);
+
+	const std::vector<Track> & tracks = tracker.tracks();
+	std::vector<std::vector<float> > out(tracks.size(), std::vector<float>(4));
+	for (size_t i = 0; i < tracks.size(); ++i) {
+		out[i][0] = tracks[i].x;
+		out[i][1] = tracks[i].y;
+		out[i][2] = tracks[i].r;
+		out[i][3] = tracks[i].id;
+	}
+	if (!out.empty())
+		out_pred.write(out);
+
+	// Kalman CORRECTION, only the newest set of detections is used
+	std::vector<std::vector<float> > meas;
+	while (!in_meas.empty())
+		meas = in_meas.read();
+
+	tracker.correct(meas);
+
+	CLOG(LDEBUG) << "Tracks: " << tracker.tracks().size() << ", detections: " << meas.size();
+}
+
+
+
+} //: namespace MultiKalman
+} //: namespace Processors
@@ -0,0 +1,103 @@
+/*!
+ * \file
+ * \brief 
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef MULTIKALMAN_HPP_
+#define MULTIKALMAN_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include "TrackManager.hpp"
+
+namespace Processors {
+namespace MultiKalman {
+
+/*!
+ * \class MultiKalman
+ * \brief MultiKalman processor class.
+ *
+ * Tracks many balls at once. All detections from a frame are associated
+ * with predicted tracks (gated, globally optimal assignment), each track
+ * is filtered with the same model as in Kalman component.
+ */
+class MultiKalman: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	MultiKalman(const std::string & name = "MultiKalman");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~MultiKalman();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to 
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<std::vector<std::vector<float> > > in_meas;
+
+	// Output data streams
+	Base::DataStreamOut<std::vector<std::vector<float> > > out_pred;
+
+	// Handlers
+
+	// Properties
+	Base::Property<int> cov_process;
+	Base::Property<int> cov_measurement;
+	Base::Property<int> gate;
+	Base::Property<int> lost;
+
+	
+	// Handlers
+	void update();
+
+	TrackManager tracker;
+	double prev_ticks;
+};
+
+} //: namespace MultiKalman
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("MultiKalman", Processors::MultiKalman::MultiKalman)
+
+#endif /* MULTIKALMAN_HPP_ */
@@ -0,0 +1,298 @@
+/*!
+ * \file
+ * \brief Set of Kalman-filtered tracks with gated data association
+ * \author Maciej Stefańczyk
+ */
+
+#include "TrackManager.hpp"
+
+#include <cmath>
+
+namespace Processors {
+namespace MultiKalman {
+
+void Track::init(int id_, float zx, float zy, float zr) {
+	id = id_;
+	lost = 0;
+
+	// same initial covariance as in Kalman component
+	x = zx;
+	vx = 0;
+	pxx = 1;
+	pxv = 0;
+	pvx = 1;
+
+	y = zy;
+	vy = 0;
+	pyy = 1;
+	pyv = 0;
+	pvy = 1;
+
+	r = zr;
+	prr = 1;
+}
+
+void Track::predict(float dt, float q) {
+	// P = A P A^T + Q for A = [1 dt; 0 1]
+	x += vx * dt;
+	pxx += dt * (2 * pxv + dt * pvx) + q;
+	pxv += dt * pvx;
+	pvx += q;
+
+	y += vy * dt;
+	pyy += dt * (2 * pyv + dt * pvy) + q;
+	pyv += dt * pvy;
+	pvy += q;
+
+	prr += q;
+}
+
+void Track::correct(float zx, float zy, float zr, float rm) {
+	// only position is measured, so K = P H^T / (H P H^T + R) = [pxx pxv]^T / (pxx + rm)
+	float s = pxx + rm;
+	float k0 = pxx / s, k1 = pxv / s;
+	float e = zx - x;
+	x += k0 * e;
+	vx += k1 * e;
+	pvx -= k1 * pxv;
+	pxv *= 1 - k0;
+	pxx *= 1 - k0;
+
+	s = pyy + rm;
+	k0 = pyy / s;
+	k1 = pyv / s;
+	e = zy - y;
+	y += k0 * e;
+	vy += k1 * e;
+	pvy -= k1 * pyv;
+	pyv *= 1 - k0;
+	pyy *= 1 - k0;
+
+	k0 = prr / (prr + rm);
+	r += k0 * (zr - r);
+	prr *= 1 - k0;
+}
+
+TrackManager::TrackManager() :
+		m_q(0.1f), m_rm(0.01f), m_gate(50), m_max_lost(50), m_next_id(0), m_hash_mask(0) {
+}
+
+void TrackManager::configure(float q, float rm, float gate, int max_lost) {
+	m_q = q;
+	m_rm = rm;
+	m_gate = gate;
+	m_max_lost = max_lost;
+}
+
+void TrackManager::predict(float dt) {
+	for (size_t i = 0; i < m_tracks.size(); ++i)
+		m_tracks[i].predict(dt, m_q);
+}
+
+void TrackManager::correct(const std::vector<std::vector<float> > & detections) {
+	buildGrid(detections);
+	gatherEdges(detections);
+	assign();
+
+	for (size_t i = 0; i < m_tracks.size(); ++i) {
+		int d = m_track_det[i];
+		if (d < 0) {
+			m_tracks[i].lost++;
+		} else {
+			const std::vector<float> & z = detections[d];
+			m_tracks[i].correct(z[0], z[1], z[2], m_rm);
+			m_tracks[i].lost = 0;
+		}
+	}
+
+	// remove lost tracks (order of tracks is irrelevant)
+	for (size_t i = 0; i < m_tracks.size(); ) {
+		if (m_tracks[i].lost >= m_max_lost) {
+			m_tracks[i] = m_tracks.back();
+			m_tracks.pop_back();
+		} else {
+			++i;
+		}
+	}
+
+	// unmatched detections start new tracks
+	for (size_t d = 0; d < detections.size(); ++d) {
+		if (m_det_track[d] >= 0 || detections[d].size() < 3)
+			continue;
+		Track t;
+		t.init(m_next_id++, detections[d][0], detections[d][1], detections[d][2]);
+		m_tracks.push_back(t);
+	}
+}
+
+int TrackManager::cellHash(int cx, int cy) const {
+	return ((unsigned) cx * 73856093u ^ (unsigned) cy * 19349663u) & m_hash_mask;
+}
+
+void TrackManager::buildGrid(const std::vector<std::vector<float> > & detections) {
+	int nd = detections.size();
+
+	// table size is power of two at least twice the number of detections
+	int size = 16;
+	while (size < 2 * nd)
+		size *= 2;
+	m_hash_mask = size - 1;
+
+	// counting sort of detections by bucket
+	m_bucket_start.assign(size + 1, 0);
+	m_det_bucket.resize(nd);
+	for (int d = 0; d < nd; ++d) {
+		if (detections[d].size() < 3) {
+			m_det_bucket[d] = -1;
+			continue;
+		}
+		int cx = std::floor(detections[d][0] / m_gate);
+		int cy = std::floor(detections[d][1] / m_gate);
+		m_det_bucket[d] = cellHash(cx, cy);
+		m_bucket_start[m_det_bucket[d] + 1]++;
+	}
+	for (int b = 0; b < size; ++b)
+		m_bucket_start[b + 1] += m_bucket_start[b];
+
+	m_bucket_dets.resize(m_bucket_start[size]);
+	m_bucket_fill.assign(size, 0);
+	for (int d = 0; d < nd; ++d) {
+		int b = m_det_bucket[d];
+		if (b >= 0)
+			m_bucket_dets[m_bucket_start[b] + m_bucket_fill[b]++] = d;
+	}
+}
+
+void TrackManager::gatherEdges(const std::vector<std::vector<float> > & detections) {
+	m_edges.clear();
+	m_visited.assign(detections.size(), -1);
+
+	float gate2 = m_gate * m_gate;
+	for (size_t i = 0; i < m_tracks.size(); ++i) {
+		const Track & t = m_tracks[i];
+		int cx = std::floor(t.x / m_gate);
+		int cy = std::floor(t.y / m_gate);
+
+		// cell size equals the gate, so 3x3 neighbourhood covers whole gate
+		for (int dy = -1; dy <= 1; ++dy) {
+			for (int dx = -1; dx <= 1; ++dx) {
+				int b = cellHash(cx + dx, cy + dy);
+				for (int k = m_bucket_start[b]; k < m_bucket_start[b + 1]; ++k) {
+					int d = m_bucket_dets[k];
+					// hash collisions may bring the same detection twice
+					if (m_visited[d] == (int) i)
+						continue;
+					m_visited[d] = i;
+
+					float ex = detections[d][0] - t.x;
+					float ey = detections[d][1] - t.y;
+					float c = ex * ex + ey * ey;
+					if (c <= gate2) {
+						Edge e = { (int) i, d, c };
+						m_edges.push_back(e);
+					}
+				}
+			}
+		}
+	}
+}
+
+int TrackManager::find(int a) {
+	while (m_parent[a] != a) {
+		m_parent[a] = m_parent[m_parent[a]];
+		a = m_parent[a];
+	}
+	return a;
+}
+
+void TrackManager::assign() {
+	int nt = m_tracks.size();
+	int nd = m_det_bucket.size();
+
+	m_track_det.assign(nt, -1);
+	m_det_track.assign(nd, -1);
+
+	// connected components of candidate graph, nodes: tracks [0, nt), detections [nt, nt + nd)
+	m_parent.resize(nt + nd);
+	for (int n = 0; n < nt + nd; ++n)
+		m_parent[n] = n;
+	for (size_t e = 0; e < m_edges.size(); ++e) {
+		int a = find(m_edges[e].track);
+		int b = find(nt + m_edges[e].det);
+		if (a != b)
+			m_parent[b] = a;
+	}
+
+	// dense component ids and local (row / column) indices of nodes
+	m_comp.assign(nt + nd, -1);
+	m_local.assign(nt + nd, -1);
+	m_comp_rows.clear();
+	m_comp_cols.clear();
+	for (size_t e = 0; e < m_edges.size(); ++e) {
+		int root = find(m_edges[e].track);
+		if (m_comp[root] < 0) {
+			m_comp[root] = m_comp_rows.size();
+			m_comp_rows.push_back(0);
+			m_comp_cols.push_back(0);
+		}
+		int c = m_comp[root];
+
+		int t = m_edges[e].track, d = nt + m_edges[e].det;
+		if (m_local[t] < 0)
+			m_local[t] = m_comp_rows[c]++;
+		if (m_local[d] < 0)
+			m_local[d] = m_comp_cols[c]++;
+	}
+
+	// edges sorted by component
+	int nc = m_comp_rows.size();
+	m_comp_edge_start.assign(nc + 1, 0);
+	for (size_t e = 0; e < m_edges.size(); ++e)
+		m_comp_edge_start[m_comp[find(m_edges[e].track)] + 1]++;
+	for (int c = 0; c < nc; ++c)
+		m_comp_edge_start[c + 1] += m_comp_edge_start[c];
+	m_comp_edges.resize(m_edges.size());
+	m_visited.assign(nc, 0);
+	for (size_t e = 0; e < m_edges.size(); ++e) {
+		int c = m_comp[find(m_edges[e].track)];
+		m_comp_edges[m_comp_edge_start[c] + m_visited[c]++] = e;
+	}
+
+	// pairs outside the gate cost more than any set of gated ones, so the solver
+	// maximizes number of matches first and total distance second
+	const double big = 1e9;
+	for (int c = 0; c < nc; ++c) {
+		int rows = m_comp_rows[c], cols = m_comp_cols[c];
+		int first = m_comp_edge_start[c], last = m_comp_edge_start[c + 1];
+
+		if (rows == 1 && cols == 1) {
+			const Edge & e = m_edges[m_comp_edges[first]];
+			m_track_det[e.track] = e.det;
+			m_det_track[e.det] = e.track;
+			continue;
+		}
+
+		m_cost.assign(rows * cols, big);
+		m_row_track.resize(rows);
+		m_col_det.resize(cols);
+		for (int k = first; k < last; ++k) {
+			const Edge & e = m_edges[m_comp_edges[k]];
+			int r = m_local[e.track], l = m_local[nt + e.det];
+			m_cost[r * cols + l] = e.cost;
+			m_row_track[r] = e.track;
+			m_col_det[l] = e.det;
+		}
+
+		m_solver.solve(m_cost, rows, cols, m_assignment);
+		for (int r = 0; r < rows; ++r) {
+			int l = m_assignment[r];
+			if (l < 0 || m_cost[r * cols + l] >= big)
+				continue;
+			m_track_det[m_row_track[r]] = m_col_det[l];
+			m_det_track[m_col_det[l]] = m_row_track[r];
+		}
+	}
+}
+
+} //: namespace MultiKalman
+} //: namespace Processors
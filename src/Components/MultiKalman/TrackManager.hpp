@@ -0,0 +1,141 @@
+/*!
+ * \file
+ * \brief Set of Kalman-filtered tracks with gated data association
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef TRACKMANAGER_HPP_
+#define TRACKMANAGER_HPP_
+
+#include <vector>
+
+#include "Hungarian.hpp"
+
+namespace Processors {
+namespace MultiKalman {
+
+/*!
+ * \class Track
+ * \brief Single ball track with constant velocity Kalman filter.
+ *
+ * Same model as in Kalman component (state [x, y, v_x, v_y, r], measurement
+ * [x, y, r], diagonal noise covariances), but written in closed form.
+ * With diagonal noises x, y and r blocks never get correlated, so covariance
+ * is kept as two 2x2 blocks and a scalar instead of full 5x5 matrix.
+ */
+struct Track {
+	/*!
+	 * Initializes track with first measurement.
+	 */
+	void init(int id, float zx, float zy, float zr);
+
+	/*!
+	 * Kalman predict step.
+	 * \param dt time elapsed since last prediction
+	 * \param q process noise variance
+	 */
+	void predict(float dt, float q);
+
+	/*!
+	 * Kalman correct step.
+	 * \param rm measurement noise variance
+	 */
+	void correct(float zx, float zy, float zr, float rm);
+
+	int id;
+	int lost;
+
+	float x, vx, pxx, pxv, pvx;
+	float y, vy, pyy, pyv, pvy;
+	float r, prr;
+};
+
+/*!
+ * \class TrackManager
+ * \brief Associates detections with tracks, manages track birth and death.
+ *
+ * Detections are put into uniform spatial hash grid with cell size equal to
+ * the gate, so each track checks only detections from its 3x3 cell
+ * neighbourhood. Gated pairs form a sparse bipartite graph, which is split into
+ * connected components, and each (usually tiny) component is solved
+ * separately with Hungarian algorithm.
+ */
+class TrackManager {
+public:
+	TrackManager();
+
+	/*!
+	 * Sets filter parameters.
+	 * \param q process noise variance
+	 * \param rm measurement noise variance
+	 * \param gate maximal distance (in pixels) between predicted position and detection
+	 * \param max_lost number of consecutive missed detections after which track is removed
+	 */
+	void configure(float q, float rm, float gate, int max_lost);
+
+	/*!
+	 * Predicts all tracks forward by dt.
+	 */
+	void predict(float dt);
+
+	/*!
+	 * Associates detections [x, y, r] with predicted tracks and corrects them.
+	 * Unmatched detections start new tracks, lost tracks are removed.
+	 */
+	void correct(const std::vector<std::vector<float> > & detections);
+
+	const std::vector<Track> & tracks() const {
+		return m_tracks;
+	}
+
+private:
+	struct Edge {
+		int track, det;
+		float cost;
+	};
+
+	void buildGrid(const std::vector<std::vector<float> > & detections);
+	void gatherEdges(const std::vector<std::vector<float> > & detections);
+	void assign();
+
+	int cellHash(int cx, int cy) const;
+	int find(int a);
+
+	float m_q, m_rm, m_gate;
+	int m_max_lost;
+	int m_next_id;
+
+	std::vector<Track> m_tracks;
+
+	// spatial hash grid - detection indices sorted by bucket
+	std::vector<int> m_bucket_start;
+	std::vector<int> m_bucket_dets;
+	std::vector<int> m_det_bucket;
+	std::vector<int> m_bucket_fill;
+	int m_hash_mask;
+
+	// gated candidate pairs
+	std::vector<Edge> m_edges;
+	std::vector<int> m_visited;
+
+	// connected components over tracks (first) and detections (next)
+	std::vector<int> m_parent;
+	std::vector<int> m_comp;
+	std::vector<int> m_local;
+	std::vector<int> m_comp_rows, m_comp_cols;
+	std::vector<int> m_comp_edge_start, m_comp_edges;
+
+	// assignment results
+	std::vector<int> m_track_det;
+	std::vector<int> m_det_track;
+
+	Hungarian m_solver;
+	std::vector<double> m_cost;
+	std::vector<int> m_assignment;
+	std::vector<int> m_row_track, m_col_det;
+};
+
+} //: namespace MultiKalman
+} //: namespace Processors
+
+#endif /* TRACKMANAGER_HPP_ */
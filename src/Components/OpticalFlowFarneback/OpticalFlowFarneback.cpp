@@ -11,10 +11,67 @@
 #include "Common/Logger.hpp"
 
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "Types/ForEach.hpp"
 
 namespace Processors {
 namespace OpticalFlowFarneback {
 
+namespace {
+
+/*!
+ * Guided filter (He et al.), used to align upsampled flow with image edges.
+ * \param guide single channel CV_32F guidance image
+ * \param src CV_32FC2 flow field of the same size
+ */
+void guidedFilter(const cv::Mat & guide, const cv::Mat & src, cv::Mat & dst, int radius, double eps) {
+	cv::Size ksize(2 * radius + 1, 2 * radius + 1);
+	
+	cv::Mat mean_I, corr_I, var_I;
+	cv::boxFilter(guide, mean_I, CV_32F, ksize);
+	cv::boxFilter(guide.mul(guide), corr_I, CV_32F, ksize);
+	var_I = corr_I - mean_I.mul(mean_I);
+	
+	std::vector<cv::Mat> p;
+	cv::split(src, p);
+	for (size_t i = 0; i < p.size(); ++i) {
+		cv::Mat mean_p, mean_Ip, a, b;
+		cv::boxFilter(p[i], mean_p, CV_32F, ksize);
+		cv::boxFilter(guide.mul(p[i]), mean_Ip, CV_32F, ksize);
+		
+		a = (mean_Ip - mean_I.mul(mean_p)) / (var_I + eps);
+		b = mean_p - a.mul(mean_I);
+		cv::boxFilter(a, a, CV_32F, ksize);
+		cv::boxFilter(b, b, CV_32F, ksize);
+		
+		p[i] = a.mul(guide) + b;
+	}
+	cv::merge(p, dst);
+}
+
+/// Rough peak memory of Farneback per pixel of its input (images, expansions, pyramid level, flow)
+const double tile_bytes_per_pixel = 112;
+
+/*!
+ * Blending weight of tile covering [lo, hi) at coordinate p. Weight falls
+ * linearly from 1 to 0 within band of half-width ov around inner tile edges,
+ * so that weights of neighbouring tiles sum up to one.
+ */
+float seamWeight(int p, int lo, int hi, int ov, int size) {
+	if (ov <= 0)
+		return p >= lo && p < hi ? 1.0f : 0.0f;
+	float c = p + 0.5f;
+	float w = 1.0f;
+	if (lo > 0)
+		w *= std::max(0.0f, std::min(1.0f, 0.5f + (c - lo) / (2 * ov)));
+	if (hi < size)
+		w *= std::max(0.0f, std::min(1.0f, 0.5f + (hi - c) / (2 * ov)));
+	return w;
+}
+
+} //: namespace
+
 OpticalFlowFarneback::OpticalFlowFarneback(const std::string & name) :
 		Base::Component(name),
 		pyr_scale("pyr_scale", 5, "range"),
@@ -23,7 +80,17 @@ OpticalFlowFarneback::OpticalFlowFarneback(const std::string & name) :
 		iterations("iterations", 3, "range"),
 		poly_n("poly_n", std::string("5"), "combo"),
 		poly_sigma("poly_sigma", 11, "range"),
-		show_vectors("show_vectors", true) {
+		show_vectors("show_vectors", true),
+		mask_padding("mask.padding", 0, "range"),
+		scale("scale", 10, "range"),
+		scale_guided("scale.guided", false),
+		async("async", false),
+		streams("streams", 1, "range"),
+		pool_priority("pool.priority", 1, "range"),
+		pool_affinity("pool.affinity", std::string("")),
+		tile_size("tile.size", 0, "range"),
+		tile_overlap("tile.overlap", 32, "range"),
+		tile_memory("tile.memory", 64, "range") {
 
 	pyr_scale.addConstraint("1");
 	pyr_scale.addConstraint("9");
@@ -41,24 +108,111 @@ OpticalFlowFarneback::OpticalFlowFarneback(const std::string & name) :
 	registerProperty(poly_sigma);
 
 	registerProperty(show_vectors);
+	
+	mask_padding.addConstraint("0");
+	mask_padding.addConstraint("200");
+	registerProperty(mask_padding);
+	
+	scale.addConstraint("1");
+	scale.addConstraint("10");
+	registerProperty(scale);
+	registerProperty(scale_guided);
+	registerProperty(async);
+	
+	// number of cameras processed by this instance, as one batch per tick
+	streams.addConstraint("1");
+	streams.addConstraint("16");
+	registerProperty(streams);
+	
+	// priority (0 - low, 2 - high) and cores (e.g. "0-3,6", empty - any) of pool tasks
+	pool_priority.addConstraint("0");
+	pool_priority.addConstraint("2");
+	registerProperty(pool_priority);
+	registerProperty(pool_affinity);
+	
+	// frames larger than tile (in pixels of decimated frame) are processed in tiles, 0 - never
+	tile_size.addConstraint("0");
+	tile_size.addConstraint("4096");
+	registerProperty(tile_size);
+	
+	// half-width of band where flow of neighbouring tiles is blended, at most half of tile
+	tile_overlap.addConstraint("0");
+	tile_overlap.addConstraint("512");
+	registerProperty(tile_overlap);
+	
+	// estimated memory (MB) of tiles processed at once by the whole instance (shared by all streams),
+	// tiles are shrunk if single one doesn't fit
+	tile_memory.addConstraint("8");
+	tile_memory.addConstraint("4096");
+	registerProperty(tile_memory);
+	
+	trace_stage = -1;
 }
 
 OpticalFlowFarneback::~OpticalFlowFarneback() {
+	worker.stop();
+	
+	for (size_t k = 1; k < channels.size(); ++k) {
+		delete channels[k].in_img;
+		delete channels[k].in_mask;
+		delete channels[k].in_stamp;
+		delete channels[k].out_flow;
+		delete channels[k].out_img;
+		delete channels[k].out_stamp;
+	}
 }
 
 void OpticalFlowFarneback::prepareInterface() {
+	channels.resize(std::max<int>(streams, 1));
+	channels[0].in_img = &in_img;
+	channels[0].in_mask = &in_mask;
+	channels[0].in_stamp = &in_stamp;
+	channels[0].out_flow = &out_flow;
+	channels[0].out_img = &out_img;
+	channels[0].out_stamp = &out_stamp;
+	
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_img", &in_img);
+	registerStream("in_mask", &in_mask);
+	registerStream("in_stamp", &in_stamp);
 	registerStream("out_flow", &out_flow);
 	registerStream("out_img", &out_img);
+	registerStream("out_dropped", &out_dropped);
+	registerStream("out_age", &out_age);
+	registerStream("out_stamp", &out_stamp);
+	
+	for (size_t k = 1; k < channels.size(); ++k) {
+		Channel & c = channels[k];
+		std::string n = boost::lexical_cast<std::string>(k);
+		c.in_img = new Base::DataStreamIn<cv::Mat>;
+		c.in_mask = new Base::DataStreamIn<cv::Mat>;
+		c.in_stamp = new Base::DataStreamIn<Types::Stamp>;
+		c.out_flow = new Base::DataStreamOut<cv::Mat>;
+		c.out_img = new Base::DataStreamOut<cv::Mat>;
+		c.out_stamp = new Base::DataStreamOut<Types::Stamp>;
+		registerStream("in_img" + n, c.in_img);
+		registerStream("in_mask" + n, c.in_mask);
+		registerStream("in_stamp" + n, c.in_stamp);
+		registerStream("out_flow" + n, c.out_flow);
+		registerStream("out_img" + n, c.out_img);
+		registerStream("out_stamp" + n, c.out_stamp);
+	}
+	
 	// Register handlers
-	registerHandler("onNewImage", boost::bind(&OpticalFlowFarneback::onNewImage, this));
-	addDependency("onNewImage", &in_img);
+	if (channels.size() > 1) {
+		// all cameras of a tick are processed together
+		registerHandler("onNewImages", boost::bind(&OpticalFlowFarneback::onNewImages, this));
+		for (size_t k = 0; k < channels.size(); ++k)
+			addDependency("onNewImages", channels[k].in_img);
+	} else {
+		registerHandler("onNewImage", boost::bind(&OpticalFlowFarneback::onNewImage, this));
+		addDependency("onNewImage", &in_img);
+	}
 
 }
 
 bool OpticalFlowFarneback::onInit() {
-
+	trace_stage = Types::Trace::stage(name());
 	return true;
 }
 
@@ -67,35 +221,132 @@ bool OpticalFlowFarneback::onFinish() {
 }
 
 bool OpticalFlowFarneback::onStop() {
+	worker.stop();
 	return true;
 }
 
 bool OpticalFlowFarneback::onStart() {
+	if (async && channels.size() > 1)
+		CLOG(LWARNING) << "OpticalFlowFarneback: async mode is not supported with multiple streams, batches are processed synchronously";
+	else if (async)
+		worker.start(boost::bind(&OpticalFlowFarneback::processStamped, this, _1));
 	return true;
 }
 
 void OpticalFlowFarneback::onNewImage() {
+	Channel & c = channels[0];
 	cv::Mat img = in_img.read();
-	cv::Mat out = img.clone();
-	cv::cvtColor(img, img, cv::COLOR_BGR2GRAY);
-	cv::Mat flow;
+	Types::Stamp stamp = Types::Trace::readStamp(in_stamp, c.stamp_seq);
+	
+	// mask is optional, last received one is used until new arrives
+	while (!in_mask.empty())
+		c.mask = in_mask.read();
+	
+	StampedPair input(MatPair(img, c.mask), stamp);
+	StampedPair res;
+	if (!worker.isRunning()) {
+		res = processStamped(input);
+	} else {
+		// async mode - hand the frame over and publish whatever is ready
+		worker.push(input);
+		if (!worker.pop(res))
+			return;
+		out_dropped.write(worker.droppedCount());
+		out_age.write(worker.resultAge());
+	}
 	
-	if (prev_img.empty()) {
-		prev_img = img.clone();
+	publish(c, res);
+}
+
+void OpticalFlowFarneback::onNewImages() {
+	Types::ThreadPool::Context pool(pool_priority, Types::ThreadPool::parseAffinity(pool_affinity));
+	
+	// streams are read and written on executor thread, only flow is computed in parallel
+	batch.resize(channels.size());
+	for (size_t k = 0; k < channels.size(); ++k) {
+		Channel & c = channels[k];
+		Types::Stamp stamp = Types::Trace::readStamp(*c.in_stamp, c.stamp_seq);
+		cv::Mat img = c.in_img->read();
+		while (!c.in_mask->empty())
+			c.mask = c.in_mask->read();
+		batch[k] = StampedPair(MatPair(img, c.mask), stamp);
+	}
+	
+	Types::ThreadPool::instance().parallelFor(cv::Range(0, batch.size()), Types::ForEach(boost::bind(&OpticalFlowFarneback::processBatch, this, _1)), batch.size());
+	
+	for (size_t k = 0; k < channels.size(); ++k)
+		publish(channels[k], batch[k]);
+}
+
+void OpticalFlowFarneback::processBatch(int k) {
+	Types::Trace::Scope trace(trace_stage, batch[k].second);
+	batch[k].first = process(channels[k], batch[k].first);
+}
+
+void OpticalFlowFarneback::publish(Channel & c, const StampedPair & res) {
+	if (res.first.first.empty())
 		return;
+	
+	c.out_stamp->write(res.second);
+	c.out_flow->write(res.first.first);
+	c.out_img->write(res.first.second);
+}
+
+OpticalFlowFarneback::StampedPair OpticalFlowFarneback::processStamped(const StampedPair & input) {
+	Types::ThreadPool::Context pool(pool_priority, Types::ThreadPool::parseAffinity(pool_affinity));
+	Types::Trace::Scope trace(trace_stage, input.second);
+	return StampedPair(process(channels[0], input.first), input.second);
+}
+
+OpticalFlowFarneback::MatPair OpticalFlowFarneback::process(Channel & c, const MatPair & input) {
+	cv::Mat img = input.first;
+	cv::Mat fg_mask = input.second;
+	
+	// all per-frame buffers live in the channel and are drawn from the frame arena, 
+	// buffers passed downstream are replaced only if still held by receivers
+	Types::FrameArena::acquire(c.gray, img.size(), CV_8UC1);
+	cv::cvtColor(img, c.gray, cv::COLOR_BGR2GRAY);
+	
+	// flow is computed on decimated frame and upsampled afterwards
+	double s = 1e-1 * scale;
+	cv::Mat & cur_img = scale < 10 ? c.small : c.gray;
+	if (scale < 10) {
+		cv::Size size(cvRound(img.cols * s), cvRound(img.rows * s));
+		Types::FrameArena::acquire(c.small, size, CV_8UC1);
+		cv::resize(c.gray, c.small, size, 0, 0, cv::INTER_AREA);
 	}
+	cv::Mat small = cur_img;
 	
-	int poly_n_int = 5;
-	if (poly_n == "5")
-		poly_n_int = 5;
-	if (poly_n == "7")
-		poly_n_int = 7;
-		
-	cv::calcOpticalFlowFarneback(prev_img, img, flow, 1e-1 * pyr_scale, levels, window, iterations, poly_n_int, 1e-1 * poly_sigma, 0 /* flags */);
+	if (c.prev_img.empty() || c.prev_img.size() != small.size()) {
+		std::swap(c.prev_img, cur_img);
+		return MatPair();
+	}
+	
+	cv::Mat small_mask = fg_mask;
+	if (!fg_mask.empty() && fg_mask.size() == img.size() && scale < 10) {
+		Types::FrameArena::acquire(c.small_mask, small.size(), fg_mask.type());
+		cv::resize(fg_mask, c.small_mask, small.size(), 0, 0, cv::INTER_AREA);
+		small_mask = c.small_mask;
+	}
 	
-	out_flow.write(flow);
+	Types::FrameArena::acquire(c.flow, small.size(), CV_32FC2);
+	cv::Mat flow = c.flow;
+	if (!small_mask.empty() && small_mask.size() == small.size()) {
+		calcMaskedFlow(c.prev_img, small, small_mask, flow);
+	} else {
+		calcFlow(c.prev_img, small, flow);
+	}
 	
+	if (scale < 10) {
+		Types::FrameArena::acquire(c.up_flow, img.size(), CV_32FC2);
+		upsampleFlow(flow, c.gray, c.up_flow);
+		flow = c.up_flow;
+	}
+	
+	Types::FrameArena::acquire(c.out_buf, img.size(), CV_8UC3);
+	cv::Mat out = c.out_buf;
 	if (show_vectors) {
+		img.copyTo(out);
 		int step = 20;
 		for (int y = step; y < out.size().height; y+=step) {
 			for (int x = step; x < out.size().width; x+=step) {
@@ -106,30 +357,192 @@ void OpticalFlowFarneback::onNewImage() {
 			}
 		}
 	} else {
-		std::vector<cv::Mat> cart;
-		std::vector<cv::Mat> polar; /* magnitude, angle */
-		polar.push_back(cv::Mat());
-		polar.push_back(cv::Mat());
+		cv::split(flow, c.cart);
 		
-		cv::split(flow, cart);
+		/* magnitude, angle */
+		cv::cartToPolar(c.cart[0], c.cart[1], c.polar[0], c.polar[1], true /* angleInDegrees */);
+		c.polar[1].convertTo(c.hsv[0], CV_8U, 0.5);
+		c.hsv[1].create(flow.size(), CV_8U);
+		c.hsv[1].setTo(255);
+		c.polar[0].convertTo(c.hsv[2], CV_8U, 10);
 		
-		cv::cartToPolar(cart[0], cart[1], polar[0], polar[1], true /* angleInDegrees */);
-		polar[0] = polar[0] * 10;
-		polar[1] = polar[1] * 0.5;
-		//cv::normalize(polar[0], polar[0], 0, 255, cv::NORM_MINMAX);
-		std::vector<cv::Mat> hsv;
-		hsv.push_back(polar[1]);
-		hsv.push_back(cv::Mat::ones(polar[0].size(), polar[0].type()) * 255);
-		hsv.push_back(polar[0]);
+		cv::merge(c.hsv, 3, c.hsv_img);
+		cv::cvtColor(c.hsv_img, out, cv::COLOR_HSV2BGR);
+	}
+	
+	// current frame becomes previous one, old previous buffer is reused for the next frame
+	std::swap(c.prev_img, cur_img);
+	
+	return MatPair(flow, out);
+}
+
+void OpticalFlowFarneback::calcFlow(const cv::Mat & prev, const cv::Mat & next, cv::Mat & flow) {
+	if (tile_size > 0 && (next.cols > tile_size || next.rows > tile_size))
+		calcTiledFlow(prev, next, flow);
+	else
+		calcFarneback(prev, next, flow);
+}
+
+void OpticalFlowFarneback::calcFarneback(const cv::Mat & prev, const cv::Mat & next, cv::Mat & flow) {
+	int poly_n_int = 5;
+	if (poly_n == "5")
+		poly_n_int = 5;
+	if (poly_n == "7")
+		poly_n_int = 7;
 		
-		cv::merge(hsv, out);
-		out.convertTo(out, CV_8UC3);
-		cv::cvtColor(out, out, cv::COLOR_HSV2BGR);
+	cv::calcOpticalFlowFarneback(prev, next, flow, 1e-1 * pyr_scale, levels, window, iterations, poly_n_int, 1e-1 * poly_sigma, 0 /* flags */);
+}
+
+void OpticalFlowFarneback::calcTiledFlow(const cv::Mat & prev, const cv::Mat & next, cv::Mat & flow) {
+	TileJob job;
+	job.prev = &prev;
+	job.next = &next;
+	job.flow = &flow;
+	job.pad = searchRange();
+	
+	int tile = tile_size;
+	job.overlap = std::min<int>(tile_overlap, tile / 2);
+	
+	// cameras of a batch are tiled concurrently, each gets equal share of the budget;
+	// single tile (with blending band and context) has to fit into the share
+	double cap = (double) tile_memory * (1 << 20) / std::max<size_t>(channels.size(), 1);
+	int fit = (int) std::sqrt(cap / tile_bytes_per_pixel) - 2 * (job.overlap + job.pad);
+	if (fit < tile) {
+		tile = std::max(fit, 32);
+		job.overlap = std::min(job.overlap, tile / 2);
 	}
 	
-	prev_img = img.clone();
+	int side = tile + 2 * (job.overlap + job.pad);
+	int slots = std::max(1, std::min<int>(cap / (tile_bytes_per_pixel * side * side), Types::ThreadPool::instance().size() + 1));
+	
+	// tiles add their weighted flow, weights of overlapping tiles sum up to one
+	flow.create(next.size(), CV_32FC2);
+	flow.setTo(cv::Scalar::all(0));
+	
+	int nx = (next.cols + tile - 1) / tile;
+	int ny = (next.rows + tile - 1) / tile;
+	cv::Rect frame(0, 0, next.cols, next.rows);
+	for (int phase = 0; phase < 4; ++phase) {
+		job.tiles.clear();
+		for (int ty = phase / 2; ty < ny; ty += 2)
+			for (int tx = phase % 2; tx < nx; tx += 2)
+				job.tiles.push_back(cv::Rect(tx * tile, ty * tile, tile, tile) & frame);
+		if (job.tiles.empty())
+			continue;
+		
+		// each stripe processes its tiles one by one, so at most slots tiles are in memory
+		Types::ThreadPool::instance().parallelFor(cv::Range(0, job.tiles.size()),
+				Types::ForEach(boost::bind(&OpticalFlowFarneback::flowTile, this, boost::cref(job), _1)),
+				std::min<int>(slots, job.tiles.size()));
+	}
+}
+
+void OpticalFlowFarneback::flowTile(const TileJob & job, int i) {
+	const cv::Rect & core = job.tiles[i];
+	const cv::Mat & next = *job.next;
+	cv::Mat & flow = *job.flow;
+	int ov = job.overlap;
+	
+	cv::Rect frame(0, 0, next.cols, next.rows);
+	cv::Rect out(core.x - ov, core.y - ov, core.width + 2 * ov, core.height + 2 * ov);
+	out &= frame;
+	cv::Rect in(out.x - job.pad, out.y - job.pad, out.width + 2 * job.pad, out.height + 2 * job.pad);
+	in &= frame;
+	
+	cv::Mat tile_flow;
+	tile_flow.allocator = &Types::FrameArena::instance();
+	calcFarneback((*job.prev)(in), next(in), tile_flow);
+	
+	// linear ramps across the band around inner seams, none at frame borders
+	std::vector<float> wx(out.width);
+	for (int x = 0; x < out.width; ++x)
+		wx[x] = seamWeight(out.x + x, core.x, core.x + core.width, ov, next.cols);
+	
+	for (int y = 0; y < out.height; ++y) {
+		float wy = seamWeight(out.y + y, core.y, core.y + core.height, ov, next.rows);
+		const cv::Point2f * src = tile_flow.ptr<cv::Point2f>(out.y + y - in.y) + (out.x - in.x);
+		cv::Point2f * dst = flow.ptr<cv::Point2f>(out.y + y) + out.x;
+		for (int x = 0; x < out.width; ++x) {
+			float w = wx[x] * wy;
+			dst[x].x += w * src[x].x;
+			dst[x].y += w * src[x].y;
+		}
+	}
+}
+
+void OpticalFlowFarneback::calcMaskedFlow(const cv::Mat & prev, const cv::Mat & next, const cv::Mat & mask, cv::Mat & flow) {
+	cv::Rect frame(0, 0, next.cols, next.rows);
+	
+	cv::Mat labels, stats, centroids;
+	int count = cv::connectedComponentsWithStats(mask > 0, labels, stats, centroids, 8, CV_32S);
+	
+	// bounding boxes of all regions (label 0 is background), padded by search range
+	int pad = searchRange();
+	std::vector<cv::Rect> rois;
+	for (int i = 1; i < count; ++i) {
+		cv::Rect r(stats.at<int>(i, cv::CC_STAT_LEFT) - pad,
+		           stats.at<int>(i, cv::CC_STAT_TOP) - pad,
+		           stats.at<int>(i, cv::CC_STAT_WIDTH) + 2 * pad,
+		           stats.at<int>(i, cv::CC_STAT_HEIGHT) + 2 * pad);
+		rois.push_back(r & frame);
+	}
+	
+	// merge overlapping boxes, so that no pixel is computed twice
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < rois.size() && !merged; ++i) {
+			for (size_t j = i + 1; j < rois.size(); ++j) {
+				if ((rois[i] & rois[j]).area() > 0) {
+					rois[i] |= rois[j];
+					rois.erase(rois.begin() + j);
+					merged = true;
+					break;
+				}
+			}
+		}
+	}
+	
+	int area = 0;
+	for (size_t i = 0; i < rois.size(); ++i)
+		area += rois[i].area();
+	
+	// when most of the frame is moving, single full pass is cheaper
+	if (4 * area > 3 * frame.area()) {
+		calcFlow(prev, next, flow);
+		return;
+	}
+	
+	flow.create(next.size(), CV_32FC2);
+	flow.setTo(cv::Scalar::all(0));
+	for (size_t i = 0; i < rois.size(); ++i) {
+		// region flow is written directly into its part of the frame flow
+		cv::Mat roi_flow = flow(rois[i]);
+		calcFlow(prev(rois[i]), next(rois[i]), roi_flow);
+	}
+}
+
+void OpticalFlowFarneback::upsampleFlow(const cv::Mat & flow, const cv::Mat & img, cv::Mat & dst) {
+	double fx = (double) img.cols / flow.cols;
+	double fy = (double) img.rows / flow.rows;
+	
+	// vectors are expressed in pixels, so they have to be scaled as well
+	cv::resize(flow, dst, img.size(), 0, 0, cv::INTER_LINEAR);
+	cv::multiply(dst, cv::Scalar(fx, fy), dst);
+	
+	if (scale_guided) {
+		cv::Mat guide;
+		img.convertTo(guide, CV_32F, 1.0 / 255);
+		guidedFilter(guide, dst, dst, cvCeil(std::max(fx, fy)), 1e-3);
+	}
+}
+
+int OpticalFlowFarneback::searchRange() {
+	if (mask_padding > 0)
+		return mask_padding;
 	
-	out_img.write(out);
+	// window size at the coarsest pyramid level, projected to full resolution
+	return cvCeil(0.5 * window * std::pow(1.0 / (1e-1 * pyr_scale), levels - 1));
 }
 
 
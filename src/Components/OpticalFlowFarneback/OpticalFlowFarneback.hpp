@@ -15,10 +15,52 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "Types/AsyncProcessor.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+#include "Types/ThreadPool.hpp"
+#include "Types/FrameArena.hpp"
+
 
 namespace Processors {
 namespace OpticalFlowFarneback {
 
+/*!
+ * \struct Channel
+ * \brief Streams and flow state of single camera.
+ */
+struct Channel {
+	/// Streams of the channel, owned by component
+	Base::DataStreamIn<cv::Mat> * in_img;
+	Base::DataStreamIn<cv::Mat> * in_mask;
+	Base::DataStreamIn<Types::Stamp> * in_stamp;
+	Base::DataStreamOut<cv::Mat> * out_flow;
+	Base::DataStreamOut<cv::Mat> * out_img;
+	Base::DataStreamOut<Types::Stamp> * out_stamp;
+
+	/// Previous (decimated) frame, swapped with the current one after each frame
+	cv::Mat prev_img;
+	/// Per-frame buffers, kept between frames so that they are reused
+	cv::Mat gray;
+	cv::Mat small;
+	cv::Mat small_mask;
+	cv::Mat flow;
+	cv::Mat up_flow;
+	cv::Mat out_buf;
+	/// Scratch of flow visualization
+	cv::Mat cart[2];
+	cv::Mat polar[2];
+	cv::Mat hsv[3];
+	cv::Mat hsv_img;
+	/// Last received mask
+	cv::Mat mask;
+	/// Number of the next frame without stamp
+	uint32_t stamp_seq;
+
+	Channel() : in_img(NULL), in_mask(NULL), in_stamp(NULL), out_flow(NULL), out_img(NULL), out_stamp(NULL), stamp_seq(0) {
+	}
+};
+
 /*!
  * \class OpticalFlowFarneback
  * \brief OpticalFlowFarneback processor class.
@@ -68,11 +110,23 @@ protected:
 
 
 	// Input data streams
+	/// Frames of the first camera, further cameras use in_img1, in_mask1, ...
 	Base::DataStreamIn<cv::Mat> in_img;
+	Base::DataStreamIn<cv::Mat> in_mask;
+	/// Capture time and number of frames on in_img (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
 
 	// Output data streams
 	Base::DataStreamOut<cv::Mat> out_flow;
 	Base::DataStreamOut<cv::Mat> out_img;
+	Base::DataStreamOut<int> out_dropped;
+	Base::DataStreamOut<double> out_age;
+	/// Stamp of the later frame of the pair flow was computed for
+	Base::DataStreamOut<Types::Stamp> out_stamp;
+	/*
+	 * Streams of further cameras (in_imgN, in_maskN, in_stampN, out_flowN, out_imgN,
+	 * out_stampN) are created in prepareInterface and owned by channels.
+	 */
 
 	// Handlers
 
@@ -84,11 +138,117 @@ protected:
 	Base::Property<std::string> poly_n;
 	Base::Property<int> poly_sigma;
 	Base::Property<bool> show_vectors;
+	Base::Property<int> mask_padding;
+	Base::Property<int> scale;
+	Base::Property<bool> scale_guided;
+	Base::Property<bool> async;
+	Base::Property<int> streams;
+	Base::Property<int> pool_priority;
+	Base::Property<std::string> pool_affinity;
+	Base::Property<int> tile_size;
+	Base::Property<int> tile_overlap;
+	Base::Property<int> tile_memory;
 	
 	// Handlers
 	void onNewImage();
+	void onNewImages();
 	
-	cv::Mat prev_img;
+	/// Pair of images: (image, mask) on input, (flow, visualisation) on output
+	typedef std::pair<cv::Mat, cv::Mat> MatPair;
+	
+	/*!
+	 * Computes flow between previous frame of channel and given frame.
+	 * Returns empty flow if there is no previous frame yet.
+	 */
+	MatPair process(Channel & c, const MatPair & input);
+	
+	/// Image pair with stamp of the camera frame
+	typedef std::pair<MatPair, Types::Stamp> StampedPair;
+	
+	/*!
+	 * Runs process() on stamped input of the first channel, recording it in the trace.
+	 */
+	StampedPair processStamped(const StampedPair & input);
+	
+	/*!
+	 * Processes input of k-th channel from current batch (parallel loop body).
+	 */
+	void processBatch(int k);
+	
+	/*!
+	 * Writes result to outputs of channel, if there is any.
+	 */
+	void publish(Channel & c, const StampedPair & res);
+	
+	/*!
+	 * Computes dense flow between two images with current parameters,
+	 * tile by tile if images are larger than tile size.
+	 */
+	void calcFlow(const cv::Mat & prev, const cv::Mat & next, cv::Mat & flow);
+	
+	/*!
+	 * Single Farneback pass over whole images.
+	 */
+	void calcFarneback(const cv::Mat & prev, const cv::Mat & next, cv::Mat & flow);
+	
+	/*!
+	 * \struct TileJob
+	 * \brief Images and layout of tiled flow computation.
+	 */
+	struct TileJob {
+		const cv::Mat * prev;
+		const cv::Mat * next;
+		cv::Mat * flow;
+		/// Cores of tiles processed in current phase
+		std::vector<cv::Rect> tiles;
+		/// Width of blending band on each side of the seam
+		int overlap;
+		/// Additional context around blended area
+		int pad;
+	};
+	
+	/*!
+	 * Computes flow in overlapping tiles written (and blended) directly into flow.
+	 * Tiles are processed in four phases, tiles of single phase don't overlap and
+	 * run in parallel, as many at once as fits into channel's share of tile.memory.
+	 */
+	void calcTiledFlow(const cv::Mat & prev, const cv::Mat & next, cv::Mat & flow);
+	
+	/*!
+	 * Computes flow of i-th tile of the job and adds it, weighted, to the job flow (parallel loop body).
+	 */
+	void flowTile(const TileJob & job, int i);
+	
+	/*!
+	 * Computes flow only inside (padded) bounding boxes of mask regions,
+	 * flow outside of them is set to zero.
+	 */
+	void calcMaskedFlow(const cv::Mat & prev, const cv::Mat & next, const cv::Mat & mask, cv::Mat & flow);
+	
+	/*!
+	 * Upsamples flow computed on decimated frame to the size of img,
+	 * optionally refining it with edge-aware filter guided by img. dst must
+	 * not share data with flow.
+	 */
+	void upsampleFlow(const cv::Mat & flow, const cv::Mat & img, cv::Mat & dst);
+	
+	/*!
+	 * Margin added around mask regions (in pixels of decimated frame),
+	 * derived from window and pyramid size if not set explicitly.
+	 */
+	int searchRange();
+	
+	/// Per-camera state, the first channel uses component's own streams
+	std::vector<Channel> channels;
+	
+	/// Inputs and results of the batch being processed
+	std::vector<StampedPair> batch;
+	
+	/// Worker used for flow computation in async mode
+	Types::AsyncProcessor<StampedPair, StampedPair> worker;
+	
+	/// Trace stage id
+	int trace_stage;
 
 };
 
@@ -0,0 +1,91 @@
+/*!
+ * \file
+ * \brief Per-camera state of sparse optical flow tracker
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef CHANNEL_HPP_
+#define CHANNEL_HPP_
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "Base/DataStream.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include "Types/Track.hpp"
+#include "Types/FlowSummary.hpp"
+#include "Types/Stamp.hpp"
+
+namespace Processors {
+namespace OpticalFlowLK {
+
+/*!
+ * \struct Channel
+ * \brief Streams, tracked points and frame history of single camera.
+ *
+ * Channels don't share any mutable state, so channels of one batch can be
+ * processed concurrently. Results are kept in the channel and published
+ * afterwards on executor thread.
+ */
+struct Channel {
+	/// Streams of the channel, owned by component
+	Base::DataStreamIn<cv::Mat> * in_img;
+	Base::DataStreamIn<Types::Stamp> * in_stamp;
+	Base::DataStreamOut<cv::Mat> * out_img;
+	Base::DataStreamOut<std::vector<cv::Vec4f> > * out_tracks;
+	Base::DataStreamOut<Types::TrackSet> * out_trackset;
+	Base::DataStreamOut<Types::FlowSummary> * out_summary;
+	Base::DataStreamOut<Types::Stamp> * out_stamp;
+
+	/// Previous and current gray frame, swapped after each frame
+	cv::Mat prev_img;
+	cv::Mat gray;
+	/// Output image buffer, drawn from the frame arena
+	cv::Mat out_buf;
+
+	/// Pyramids of prev_img and current frame, rotated like the images
+	std::vector<cv::Mat> prev_pyr;
+	std::vector<cv::Mat> pyr;
+	bool prev_pyr_ready;
+	/// Window and number of levels prev_pyr was built for
+	int pyr_window;
+	int pyr_levels;
+
+	std::vector<cv::Point2f> points[2];
+	/// Identifiers of points[0]
+	std::vector<uint32_t> ids;
+	uint32_t next_id;
+
+	/// Clear and reinitialize requests waiting for the next frame
+	bool clear;
+	bool reinit;
+	/// Points added manually, waiting for the next frame
+	std::vector<cv::Point2f> new_points;
+
+	/// Capture time of prev_img (seconds)
+	double prev_time;
+	/// Number of the next frame without stamp
+	uint32_t stamp_seq;
+
+	/// Results of the last frame, valid if has_result is set
+	bool has_result;
+	Types::Stamp stamp;
+	cv::Mat result_img;
+	std::vector<cv::Vec4f> tracks;
+	Types::TrackSet trackset;
+	Types::FlowSummary summary;
+
+	Channel() : in_img(NULL), in_stamp(NULL), out_img(NULL), out_tracks(NULL), out_trackset(NULL), out_summary(NULL),
+			out_stamp(NULL), prev_pyr_ready(false), pyr_window(0), pyr_levels(0), next_id(0), clear(false),
+			reinit(false), prev_time(0), stamp_seq(0), has_result(false) {
+		trackset.clear();
+	}
+};
+
+} //: namespace OpticalFlowLK
+} //: namespace Processors
+
+#endif /* CHANNEL_HPP_ */
@@ -11,6 +11,9 @@
 #include "Common/Logger.hpp"
 
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "Types/ForEach.hpp"
 
 namespace Processors {
 namespace OpticalFlowLK {
@@ -26,7 +29,10 @@ OpticalFlowLK::OpticalFlowLK(const std::string & name) :
 		detector_quality("detector.quality", 10, "range"), 
 		detector_min_dist("detector.min_dist", 10, "range"), 
 		detector_block_size("detector.block_size", 1, "range"),
-		detector_subpix("detector.subpix", 5, "range") {
+		detector_subpix("detector.subpix", 5, "range"),
+		pool_priority("pool.priority", 1, "range"),
+		pool_affinity("pool.affinity", std::string("")),
+		streams("streams", 1, "range") {
 	
 	registerProperty(tracker_window);
 	registerProperty(tracker_pyramids);
@@ -41,28 +47,91 @@ OpticalFlowLK::OpticalFlowLK(const std::string & name) :
 	registerProperty(detector_min_dist);
 	registerProperty(detector_block_size);
 	registerProperty(detector_subpix);
+	
+	// priority (0 - low, 2 - high) and cores (e.g. "0-3,6", empty - any) of pool tasks
+	pool_priority.addConstraint("0");
+	pool_priority.addConstraint("2");
+	registerProperty(pool_priority);
+	registerProperty(pool_affinity);
+	
+	// number of cameras processed by this instance, as one batch per tick
+	streams.addConstraint("1");
+	streams.addConstraint("16");
+	registerProperty(streams);
 
 	flag_reinit = false;
 	flag_clear = false;
+	trace_stage = -1;
 }
 
 OpticalFlowLK::~OpticalFlowLK() {
+	for (size_t k = 1; k < channels.size(); ++k) {
+		delete channels[k].in_img;
+		delete channels[k].in_stamp;
+		delete channels[k].out_img;
+		delete channels[k].out_tracks;
+		delete channels[k].out_trackset;
+		delete channels[k].out_summary;
+		delete channels[k].out_stamp;
+	}
 }
 
 void OpticalFlowLK::prepareInterface() {
+	channels.resize(std::max<int>(streams, 1));
+	channels[0].in_img = &in_img;
+	channels[0].in_stamp = &in_stamp;
+	channels[0].out_img = &out_img;
+	channels[0].out_tracks = &out_tracks;
+	channels[0].out_trackset = &out_trackset;
+	channels[0].out_summary = &out_summary;
+	channels[0].out_stamp = &out_stamp;
+	
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_img", &in_img);
 	registerStream("in_point", &in_point);
+	registerStream("in_stamp", &in_stamp);
 	registerStream("out_img", &out_img);
+	registerStream("out_tracks", &out_tracks);
+	registerStream("out_trackset", &out_trackset);
+	registerStream("out_summary", &out_summary);
+	registerStream("out_stamp", &out_stamp);
+	
+	for (size_t k = 1; k < channels.size(); ++k) {
+		Channel & c = channels[k];
+		std::string n = boost::lexical_cast<std::string>(k);
+		c.in_img = new Base::DataStreamIn<cv::Mat>;
+		c.in_stamp = new Base::DataStreamIn<Types::Stamp>;
+		c.out_img = new Base::DataStreamOut<cv::Mat>;
+		c.out_tracks = new Base::DataStreamOut<std::vector<cv::Vec4f> >;
+		c.out_trackset = new Base::DataStreamOut<Types::TrackSet>;
+		c.out_summary = new Base::DataStreamOut<Types::FlowSummary>;
+		c.out_stamp = new Base::DataStreamOut<Types::Stamp>;
+		registerStream("in_img" + n, c.in_img);
+		registerStream("in_stamp" + n, c.in_stamp);
+		registerStream("out_img" + n, c.out_img);
+		registerStream("out_tracks" + n, c.out_tracks);
+		registerStream("out_trackset" + n, c.out_trackset);
+		registerStream("out_summary" + n, c.out_summary);
+		registerStream("out_stamp" + n, c.out_stamp);
+	}
+	
 	// Register handlers
-	registerHandler("onNewImage", boost::bind(&OpticalFlowLK::onNewImage, this));
-	addDependency("onNewImage", &in_img);
+	if (channels.size() > 1) {
+		// all cameras of a tick are processed together
+		registerHandler("onNewImages", boost::bind(&OpticalFlowLK::onNewImages, this));
+		for (size_t k = 0; k < channels.size(); ++k)
+			addDependency("onNewImages", channels[k].in_img);
+	} else {
+		registerHandler("onNewImage", boost::bind(&OpticalFlowLK::onNewImage, this));
+		addDependency("onNewImage", &in_img);
+	}
 	registerHandler("Clear", boost::bind(&OpticalFlowLK::Clear, this));
 	registerHandler("Reinitialize", boost::bind(&OpticalFlowLK::Reinitialize, this));
 
 }
 
 bool OpticalFlowLK::onInit() {
+	trace_stage = Types::Trace::stage(name());
 
 	return true;
 }
@@ -80,54 +149,132 @@ bool OpticalFlowLK::onStart() {
 }
 
 void OpticalFlowLK::onNewImage() {
+	Channel & c = channels[0];
+	cv::Mat frame = read(c);
+	flag_clear = flag_reinit = false;
+	
+	Types::Trace::Scope trace(trace_stage, c.stamp);
+	Types::ThreadPool::Context pool(pool_priority, Types::ThreadPool::parseAffinity(pool_affinity));
+	
+	process(c, frame);
+	publish(c);
+}
+
+void OpticalFlowLK::onNewImages() {
+	Types::ThreadPool::Context pool(pool_priority, Types::ThreadPool::parseAffinity(pool_affinity));
 	
-	cv::Mat img = in_img.read();
-	cv::Mat out = img.clone();
+	// streams are read and written on executor thread, only tracking runs in parallel
+	batch.resize(channels.size());
+	for (size_t k = 0; k < channels.size(); ++k)
+		batch[k] = read(channels[k]);
+	flag_clear = flag_reinit = false;
+	
+	Types::ThreadPool::instance().parallelFor(cv::Range(0, batch.size()), Types::ForEach(boost::bind(&OpticalFlowLK::processBatch, this, _1)), batch.size());
+	
+	for (size_t k = 0; k < channels.size(); ++k) {
+		publish(channels[k]);
+		batch[k].release();
+	}
+}
+
+void OpticalFlowLK::processBatch(int k) {
+	Types::Trace::Scope trace(trace_stage, channels[k].stamp);
+	process(channels[k], batch[k]);
+}
+
+cv::Mat OpticalFlowLK::read(Channel & c) {
+	cv::Mat frame = c.in_img->read();
+	c.stamp = Types::Trace::readStamp(*c.in_stamp, c.stamp_seq);
+	
+	// requests stay in the channel until it has a frame to apply them to
+	c.clear = c.clear || flag_clear;
+	c.reinit = c.reinit || flag_reinit;
+	if (&c == &channels[0])
+		while (!in_point.empty())
+			c.new_points.push_back(in_point.read());
+	
+	return frame;
+}
+
+void OpticalFlowLK::process(Channel & c, const cv::Mat & frame) {
+	c.has_result = false;
+	
+	// output image is passed downstream, so it is taken fresh from the arena unless previous one was already released
+	Types::FrameArena::acquire(c.out_buf, frame.size(), frame.type());
+	frame.copyTo(c.out_buf);
+	cv::Mat out = c.out_buf;
 	
 	cv::TermCriteria termcrit(cv::TermCriteria::COUNT|cv::TermCriteria::EPS, tracker_term_count, 1e-3 * tracker_term_eps);
 	
-	cv::cvtColor(img, img, cv::COLOR_BGR2GRAY);
+	// gray buffer and prev_img are swapped after each frame instead of copying
+	Types::FrameArena::acquire(c.gray, frame.size(), CV_8UC1);
+	cv::cvtColor(frame, c.gray, cv::COLOR_BGR2GRAY);
+	cv::Mat img = c.gray;
 	
-	if (prev_img.empty()) {
-		prev_img = img.clone();
+	if (c.prev_img.empty()) {
+		std::swap(c.prev_img, c.gray);
+		c.prev_pyr_ready = false;
+		c.prev_time = c.stamp.capture;
 		return;
 	}
 	
-	if (flag_clear) {
-		flag_clear = false;
+	// velocities are computed from capture times, not processing times
+	float dt = c.stamp.capture - c.prev_time;
+	
+	std::vector<cv::Point2f> * points = c.points;
+	
+	if (c.clear) {
+		c.clear = false;
 		points[0].clear();
 		points[1].clear();
+		c.ids.clear();
 	}
 	
-	if (flag_reinit) {
+	if (c.reinit) {
 		cv::Size subPixWinSize(detector_subpix * 2 + 1, detector_subpix * 2 + 1);
 		cv::goodFeaturesToTrack(img, points[0], detector_count, 1e-3 * detector_quality, detector_min_dist, cv::Mat(), detector_block_size * 2 + 1, 0, 0.04);
 		cornerSubPix(img, points[0], subPixWinSize, cv::Size(-1,-1), termcrit);
-		flag_reinit = false;
+		c.ids.resize(points[0].size());
+		for (size_t i = 0; i < c.ids.size(); ++i)
+			c.ids[i] = c.next_id++;
+		c.reinit = false;
 	}
 	
 	
 	cv::Size winSize(tracker_window*2+1, tracker_window*2+1);
 	
-	while (!in_point.empty()) {
-		std::vector<cv::Point2f> tmp;
-		tmp.push_back(in_point.read());
-		std::cout << tmp[0];
-		cv::cornerSubPix( img, tmp, winSize, cv::Size(-1,-1), termcrit);
-		points[0].push_back(tmp[0]);
-		std::cout << " | " << tmp[0] << std::endl;
+	if (!c.new_points.empty()) {
+		cv::cornerSubPix( img, c.new_points, winSize, cv::Size(-1,-1), termcrit);
+		for (size_t i = 0; i < c.new_points.size(); ++i) {
+			points[0].push_back(c.new_points[i]);
+			c.ids.push_back(c.next_id++);
+		}
+		c.new_points.clear();
 	}
 	
+	c.tracks.clear();
+	c.has_result = true;
+	
+	std::vector<uchar> status;
+	
 	if (points[0].empty()) {
-		out_img.write(img);
+		fillTracks(c, status, dt);
+		c.result_img = img;
 		return;
 	}
 	
-	std::vector<uchar> status;
-	std::vector<float> err;
-	cv::calcOpticalFlowPyrLK(prev_img, img, points[0], points[1], status, err, winSize, tracker_pyramids, termcrit, 0, 1e-4 * tracker_min_eigen);
+	// pyramid of current frame is kept for the next one, so each frame is decomposed only once
+	if (!c.prev_pyr_ready || c.pyr_window != winSize.width || c.pyr_levels != tracker_pyramids) {
+		c.pyr_window = winSize.width;
+		c.pyr_levels = tracker_pyramids;
+		cv::buildOpticalFlowPyramid(c.prev_img, c.prev_pyr, winSize, c.pyr_levels);
+	}
+	int levels = cv::buildOpticalFlowPyramid(img, c.pyr, winSize, c.pyr_levels);
 	
+	std::vector<float> err;
+	cv::calcOpticalFlowPyrLK(c.prev_pyr, c.pyr, points[0], points[1], status, err, winSize, levels, termcrit, 0, 1e-4 * tracker_min_eigen);
 	
+	fillTracks(c, status, dt);
 	
 	size_t i, k;
 	for( i = k = 0; i < points[1].size(); i++ )
@@ -135,17 +282,83 @@ void OpticalFlowLK::onNewImage() {
 		if( !status[i] )
 			continue;
 
-		points[1][k++] = points[1][i];
+		c.tracks.push_back(cv::Vec4f(points[0][i].x, points[0][i].y, points[1][i].x, points[1][i].y));
 		cv::circle( out, points[1][i], 3, cv::Scalar(0,255,0), -1, 8);
 		cv::line(out, points[0][i], points[1][i], cv::Scalar(0, 0, 255), 1, 8);
+		c.ids[k] = c.ids[i];
+		points[1][k++] = points[1][i];
 	}
 	points[1].resize(k);
+	c.ids.resize(k);
 		
 	points[0] = points[1];
 		
-	out_img.write(out);
+	c.result_img = out;
+	
+	std::swap(c.prev_img, c.gray);
+	c.prev_pyr.swap(c.pyr);
+	c.prev_pyr_ready = true;
+	c.prev_time = c.stamp.capture;
+}
+
+void OpticalFlowLK::fillTracks(Channel & c, const std::vector<uchar> & status, float dt) {
+	double timestamp = c.stamp.capture;
+	const std::vector<cv::Point2f> * points = c.points;
+	
+	Types::FlowSummary & summary = c.summary;
+	summary.timestamp = timestamp;
+	summary.id = c.stamp.seq;
+	summary.count = 0;
+	summary.mean_vx = summary.mean_vy = 0;
+	summary.mean_speed = summary.max_speed = 0;
+	
+	c.trackset.timestamp = timestamp;
+	c.trackset.id = c.stamp.seq;
+	c.trackset.clear();
+	
+	float inv_dt = dt > 0 ? 1.0f / dt : 0;
+	for (size_t i = 0; i < status.size(); ++i) {
+		if (!status[i])
+			continue;
+		
+		Types::Track t;
+		t.timestamp = timestamp;
+		t.id = c.ids[i];
+		t.lost = 0;
+		t.x = points[1][i].x;
+		t.y = points[1][i].y;
+		t.r = 0;
+		t.vx = (points[1][i].x - points[0][i].x) * inv_dt;
+		t.vy = (points[1][i].y - points[0][i].y) * inv_dt;
+		c.trackset.add(t);
+		
+		float speed = std::sqrt(t.vx * t.vx + t.vy * t.vy);
+		summary.count++;
+		summary.mean_vx += t.vx;
+		summary.mean_vy += t.vy;
+		summary.mean_speed += speed;
+		summary.max_speed = std::max(summary.max_speed, speed);
+	}
+	
+	if (summary.count > 0) {
+		summary.mean_vx /= summary.count;
+		summary.mean_vy /= summary.count;
+		summary.mean_speed /= summary.count;
+	}
+}
+
+void OpticalFlowLK::publish(Channel & c) {
+	if (!c.has_result)
+		return;
+	
+	c.out_stamp->write(c.stamp);
+	c.out_trackset->write(c.trackset);
+	c.out_summary->write(c.summary);
+	c.out_tracks->write(c.tracks);
+	c.out_img->write(c.result_img);
 	
-	prev_img = img.clone();
+	// result image is a view of arena buffer, it mustn't keep it referenced until the next frame
+	c.result_img.release();
 }
 
 void OpticalFlowLK::Clear() {
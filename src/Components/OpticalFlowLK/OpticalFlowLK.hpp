@@ -15,6 +15,15 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "Types/Track.hpp"
+#include "Types/FlowSummary.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+#include "Types/ThreadPool.hpp"
+#include "Types/FrameArena.hpp"
+
+#include "Channel.hpp"
+
 
 namespace Processors {
 namespace OpticalFlowLK {
@@ -68,11 +77,26 @@ protected:
 
 
 	// Input data streams
+	/// Frames of the first camera, further cameras use in_img1, in_img2, ...
 	Base::DataStreamIn<cv::Mat> in_img;
 	Base::DataStreamIn<cv::Point2f> in_point;
+	/// Capture time and number of frames on in_img (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
 
 	// Output data streams
 	Base::DataStreamOut<cv::Mat> out_img;
+	/// Successfully tracked points, each as (x_prev, y_prev, x_cur, y_cur)
+	Base::DataStreamOut<std::vector<cv::Vec4f> > out_tracks;
+	/// Tracked points with persistent ids and velocities
+	Base::DataStreamOut<Types::TrackSet> out_trackset;
+	Base::DataStreamOut<Types::FlowSummary> out_summary;
+	/// Stamp of the frame tracks were computed on
+	Base::DataStreamOut<Types::Stamp> out_stamp;
+	/*
+	 * Streams of further cameras (in_imgN, in_stampN, out_imgN, out_tracksN,
+	 * out_tracksetN, out_summaryN, out_stampN) are created in prepareInterface
+	 * and owned by channels. Points from in_point are added to the first camera.
+	 */
 
 	// Handlers
 
@@ -87,19 +111,53 @@ protected:
 	Base::Property<int> detector_min_dist;
 	Base::Property<int> detector_block_size;
 	Base::Property<int> detector_subpix;
+	Base::Property<int> pool_priority;
+	Base::Property<std::string> pool_affinity;
+	Base::Property<int> streams;
 
 	
 	// Handlers
 	void onNewImage();
+	void onNewImages();
 	void Clear();
 	void Reinitialize();
 	
 	bool flag_reinit;
 	bool flag_clear;
 	
-	cv::Mat prev_img;
+	/*!
+	 * Reads frame and stamp of the channel and hands pending requests over to it.
+	 */
+	cv::Mat read(Channel & c);
+	
+	/*!
+	 * Tracks points of channel in given frame, results are stored in the channel.
+	 */
+	void process(Channel & c, const cv::Mat & frame);
+	
+	/*!
+	 * Processes k-th channel of current batch (parallel loop body).
+	 */
+	void processBatch(int k);
+	
+	/*!
+	 * Fills trackset and summary of channel with successfully tracked points.
+	 */
+	void fillTracks(Channel & c, const std::vector<uchar> & status, float dt);
+	
+	/*!
+	 * Writes results of the last frame to outputs of channel, if there are any.
+	 */
+	void publish(Channel & c);
+	
+	/// Per-camera state, the first channel uses component's own streams
+	std::vector<Channel> channels;
+	
+	/// Frames of the batch being processed
+	std::vector<cv::Mat> batch;
 	
-	std::vector<cv::Point2f> points[2];
+	/// Trace stage id
+	int trace_stage;
 
 };
 
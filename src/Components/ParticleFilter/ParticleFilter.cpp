@@ -0,0 +1,314 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+
+#include "ParticleFilter.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+#include "Types/ThreadPool.hpp"
+
+namespace Processors {
+namespace ParticleFilter {
+
+namespace {
+
+/*!
+ * Constant velocity motion with gaussian noise, for a range of particles.
+ */
+class Propagate : public cv::ParallelLoopBody {
+public:
+	Propagate(cv::Mat & state_, const cv::Mat & noise_, float dt_, float sp_, float sv_, float sr_) :
+		state(state_), noise(noise_), dt(dt_), sp(sp_), sv(sv_), sr(sr_) {
+	}
+
+	void operator()(const cv::Range & range) const {
+		float * x = state.ptr<float>(0);
+		float * y = state.ptr<float>(1);
+		float * vx = state.ptr<float>(2);
+		float * vy = state.ptr<float>(3);
+		float * r = state.ptr<float>(4);
+		const float * n0 = noise.ptr<float>(0);
+		const float * n1 = noise.ptr<float>(1);
+		const float * n2 = noise.ptr<float>(2);
+		const float * n3 = noise.ptr<float>(3);
+		const float * n4 = noise.ptr<float>(4);
+
+		for (int i = range.start; i < range.end; ++i) {
+			x[i] += vx[i] * dt + sp * n0[i];
+			y[i] += vy[i] * dt + sp * n1[i];
+			vx[i] += sv * n2[i];
+			vy[i] += sv * n3[i];
+			r[i] = std::max(r[i] + sr * n4[i], 1.0f);
+		}
+	}
+
+private:
+	cv::Mat & state;
+	const cv::Mat & noise;
+	float dt, sp, sv, sr;
+};
+
+/*!
+ * Squared distance of particles from measurement, for a range of particles.
+ */
+class Distance : public cv::ParallelLoopBody {
+public:
+	Distance(const cv::Mat & state_, cv::Mat & dist_, float zx_, float zy_, float zr_) :
+		state(state_), dist(dist_), zx(zx_), zy(zy_), zr(zr_) {
+	}
+
+	void operator()(const cv::Range & range) const {
+		const float * x = state.ptr<float>(0);
+		const float * y = state.ptr<float>(1);
+		const float * r = state.ptr<float>(4);
+		float * d = dist.ptr<float>(0);
+
+		for (int i = range.start; i < range.end; ++i) {
+			float ex = x[i] - zx, ey = y[i] - zy, er = r[i] - zr;
+			d[i] = ex * ex + ey * ey + er * er;
+		}
+	}
+
+private:
+	const cv::Mat & state;
+	cv::Mat & dist;
+	float zx, zy, zr;
+};
+
+/// Number of particles processed by single task in parallel mode
+const int chunk = 1024;
+
+} //: namespace
+
+ParticleFilter::ParticleFilter(const std::string & name) :
+		Base::Component(name),
+		particles("particles", 2000, "range"),
+		noise_position("noise.position", 2, "range"),
+		noise_velocity("noise.velocity", 20, "range"),
+		noise_radius("noise.radius", 1, "range"),
+		sigma("sigma", 10, "range"),
+		outliers("outliers", 5, "range"),
+		lost("lost", 50, "range"),
+		parallel("parallel", false)  {
+
+	particles.addConstraint("100");
+	particles.addConstraint("100000");
+	registerProperty(particles);
+
+	// standard deviations of motion noise per step, in pixels (velocity in pixels per second)
+	noise_position.addConstraint("0");
+	noise_position.addConstraint("100");
+	registerProperty(noise_position);
+	noise_velocity.addConstraint("0");
+	noise_velocity.addConstraint("1000");
+	registerProperty(noise_velocity);
+	noise_radius.addConstraint("0");
+	noise_radius.addConstraint("100");
+	registerProperty(noise_radius);
+
+	// standard deviation of measurement, in pixels
+	sigma.addConstraint("1");
+	sigma.addConstraint("100");
+	registerProperty(sigma);
+
+	// probability (in percents) that measurement is clutter, keeps filter alive after false detections
+	outliers.addConstraint("0");
+	outliers.addConstraint("50");
+	registerProperty(outliers);
+
+	lost.addConstraint("1");
+	lost.addConstraint("500");
+	registerProperty(lost);
+
+	registerProperty(parallel);
+
+	tracking = false;
+	lost_counter = 0;
+	prev_ticks = 0;
+}
+
+ParticleFilter::~ParticleFilter() {
+}
+
+void ParticleFilter::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_meas", &in_meas);
+	registerStream("out_pred", &out_pred);
+	// Register handlers
+	registerHandler("update", boost::bind(&ParticleFilter::update, this));
+	addDependency("update", NULL);
+
+}
+
+bool ParticleFilter::onInit() {
+
+	return true;
+}
+
+bool ParticleFilter::onFinish() {
+	return true;
+}
+
+bool ParticleFilter::onStop() {
+	return true;
+}
+
+bool ParticleFilter::onStart() {
+	prev_ticks = (double) cv::getTickCount();
+	return true;
+}
+
+void ParticleFilter::update() {
+	double ticks = (double) cv::getTickCount();
+	double dT = (ticks - prev_ticks) / cv::getTickFrequency(); //seconds
+	prev_ticks = ticks;
+
+	// PREDICT
+	if (tracking) {
+		propagate(dT);
+		out_pred.write(estimate());
+	}
+
+	if (in_meas.empty()) {
+		lost_counter++;
+		if (lost_counter >= lost)
+			tracking = false;
+		return;
+	}
+
+	std::vector<float> z;
+	while (!in_meas.empty())
+		z = in_meas.read();
+	if (z.size() < 3)
+		return;
+	lost_counter = 0;
+
+	if (!tracking) {
+		initialize(z);
+		tracking = true;
+		return;
+	}
+
+	// CORRECT
+	weigh(z);
+	resample();
+}
+
+void ParticleFilter::initialize(const std::vector<float> & z) {
+	int n = particles;
+
+	// all buffers are allocated here, so that steps do not allocate at all
+	state.create(5, n, CV_32F);
+	state_tmp.create(5, n, CV_32F);
+	noise.create(5, n, CV_32F);
+	weights.create(1, n, CV_32F);
+	cumulative.resize(n);
+
+	rng.fill(noise, cv::RNG::NORMAL, 0, 1);
+	float s = sigma;
+	for (int i = 0; i < n; ++i) {
+		state.at<float>(0, i) = z[0] + s * noise.at<float>(0, i);
+		state.at<float>(1, i) = z[1] + s * noise.at<float>(1, i);
+		state.at<float>(2, i) = noise_velocity * noise.at<float>(2, i);
+		state.at<float>(3, i) = noise_velocity * noise.at<float>(3, i);
+		state.at<float>(4, i) = std::max(z[2] + s * noise.at<float>(4, i), 1.0f);
+	}
+	weights.setTo(1);
+}
+
+void ParticleFilter::propagate(float dt) {
+	rng.fill(noise, cv::RNG::NORMAL, 0, 1);
+
+	Propagate body(state, noise, dt, noise_position, noise_velocity, noise_radius);
+	cv::Range range(0, state.cols);
+	if (parallel)
+		Types::ThreadPool::instance().parallelFor(range, body, (state.cols + chunk - 1) / chunk);
+	else
+		body(range);
+}
+
+void ParticleFilter::weigh(const std::vector<float> & z) {
+	Distance body(state, weights, z[0], z[1], z[2]);
+	cv::Range range(0, state.cols);
+	if (parallel)
+		Types::ThreadPool::instance().parallelFor(range, body, (state.cols + chunk - 1) / chunk);
+	else
+		body(range);
+
+	// gaussian likelihood, relative to the best particle to avoid underflow
+	double d_min;
+	cv::minMaxLoc(weights, &d_min);
+	double k = -0.5 / (sigma * sigma);
+	weights.convertTo(weights, CV_32F, k, -k * d_min);
+	cv::exp(weights, weights);
+
+	// mixture with uniform clutter
+	double o = 0.01 * outliers;
+	weights.convertTo(weights, CV_32F, 1 - o, o);
+}
+
+void ParticleFilter::resample() {
+	int n = state.cols;
+	const float * w = weights.ptr<float>(0);
+
+	double sum = 0;
+	for (int i = 0; i < n; ++i) {
+		sum += w[i];
+		cumulative[i] = sum;
+	}
+
+	const float * src[5];
+	float * dst[5];
+	for (int k = 0; k < 5; ++k) {
+		src[k] = state.ptr<float>(k);
+		dst[k] = state_tmp.ptr<float>(k);
+	}
+
+	// single random offset, equally spaced pointers
+	double step = sum / n;
+	double u = rng.uniform(0.0, step);
+	int j = 0;
+	for (int i = 0; i < n; ++i, u += step) {
+		while (j < n - 1 && cumulative[j] < u)
+			++j;
+		for (int k = 0; k < 5; ++k)
+			dst[k][i] = src[k][j];
+	}
+
+	cv::swap(state, state_tmp);
+	weights.setTo(1);
+}
+
+std::vector<float> ParticleFilter::estimate() {
+	int n = state.cols;
+	const float * x = state.ptr<float>(0);
+	const float * y = state.ptr<float>(1);
+	const float * r = state.ptr<float>(4);
+	const float * w = weights.ptr<float>(0);
+
+	double sw = 0, sx = 0, sy = 0, sr = 0;
+	for (int i = 0; i < n; ++i) {
+		sw += w[i];
+		sx += w[i] * x[i];
+		sy += w[i] * y[i];
+		sr += w[i] * r[i];
+	}
+
+	std::vector<float> out;
+	out.push_back(sx / sw);
+	out.push_back(sy / sw);
+	out.push_back(sr / sw);
+	return out;
+}
+
+
+
+} //: namespace ParticleFilter
+} //: namespace Processors
@@ -0,0 +1,143 @@
+/*!
+ * \file
+ * \brief 
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef PARTICLEFILTER_HPP_
+#define PARTICLEFILTER_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+
+namespace Processors {
+namespace ParticleFilter {
+
+/*!
+ * \class ParticleFilter
+ * \brief ParticleFilter processor class.
+ *
+ * Ball tracker with the same interface as Kalman, but using particle filter,
+ * which copes with occlusions and sudden changes of motion (bounces).
+ * Particles are kept as separate float arrays for each state variable,
+ * so propagation and weighting are simple vectorizable loops.
+ */
+class ParticleFilter: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	ParticleFilter(const std::string & name = "ParticleFilter");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~ParticleFilter();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to 
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<std::vector<float> > in_meas;
+
+	// Output data streams
+	Base::DataStreamOut<std::vector<float> > out_pred;
+
+	// Handlers
+
+	// Properties
+	Base::Property<int> particles;
+	Base::Property<int> noise_position;
+	Base::Property<int> noise_velocity;
+	Base::Property<int> noise_radius;
+	Base::Property<int> sigma;
+	Base::Property<int> outliers;
+	Base::Property<int> lost;
+	Base::Property<bool> parallel;
+
+	
+	// Handlers
+	void update();
+
+	/*!
+	 * Spreads particles around first measurement.
+	 */
+	void initialize(const std::vector<float> & z);
+
+	/*!
+	 * Moves particles according to motion model with random noise.
+	 */
+	void propagate(float dt);
+
+	/*!
+	 * Computes weights of particles given measurement.
+	 */
+	void weigh(const std::vector<float> & z);
+
+	/*!
+	 * Systematic resampling, new particles are written to spare buffer which is swapped afterwards.
+	 */
+	void resample();
+
+	/*!
+	 * Weighted mean of particles.
+	 */
+	std::vector<float> estimate();
+
+	/// Particles, rows: x, y, v_x, v_y, r
+	cv::Mat state, state_tmp;
+	/// Particle weights (single row)
+	cv::Mat weights;
+	/// Preallocated noise and cumulative weights
+	cv::Mat noise;
+	std::vector<double> cumulative;
+
+	cv::RNG rng;
+
+	bool tracking;
+	int lost_counter;
+	double prev_ticks;
+};
+
+} //: namespace ParticleFilter
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("ParticleFilter", Processors::ParticleFilter::ParticleFilter)
+
+#endif /* PARTICLEFILTER_HPP_ */
@@ -0,0 +1,171 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+#include <cmath>
+
+#include "SparseToDenseFlow.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace SparseToDenseFlow {
+
+SparseToDenseFlow::SparseToDenseFlow(const std::string & name) :
+		Base::Component(name),
+		max_flow("max_flow", 100, "range") {
+
+	// tracks with longer displacement (in pixels) are treated as outliers
+	max_flow.addConstraint("1");
+	max_flow.addConstraint("1000");
+	registerProperty(max_flow);
+}
+
+SparseToDenseFlow::~SparseToDenseFlow() {
+}
+
+void SparseToDenseFlow::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_tracks", &in_tracks);
+	registerStream("in_img", &in_img);
+	registerStream("out_flow", &out_flow);
+	// Register handlers
+	registerHandler("onNewTracks", boost::bind(&SparseToDenseFlow::onNewTracks, this));
+	addDependency("onNewTracks", &in_tracks);
+
+}
+
+bool SparseToDenseFlow::onInit() {
+
+	return true;
+}
+
+bool SparseToDenseFlow::onFinish() {
+	return true;
+}
+
+bool SparseToDenseFlow::onStop() {
+	return true;
+}
+
+bool SparseToDenseFlow::onStart() {
+	return true;
+}
+
+void SparseToDenseFlow::onNewTracks() {
+	std::vector<cv::Vec4f> tracks = in_tracks.read();
+	while (!in_img.empty())
+		size = in_img.read().size();
+
+	if (size.area() == 0)
+		return;
+
+	cv::Mat flow(size, CV_32FC2, cv::Scalar::all(0));
+	cv::Rect frame(0, 0, size.width, size.height);
+
+	points.clear();
+	flows.clear();
+	float max2 = max_flow * max_flow;
+	for (size_t i = 0; i < tracks.size(); ++i) {
+		cv::Point2f p(tracks[i][0], tracks[i][1]);
+		cv::Point2f d(tracks[i][2] - p.x, tracks[i][3] - p.y);
+		if (!frame.contains(p) || d.dot(d) > max2)
+			continue;
+		points.push_back(p);
+		flows.push_back(d);
+	}
+
+	if (points.empty()) {
+		out_flow.write(flow);
+		return;
+	}
+
+	// corners get flow of the nearest track, so that triangulation covers whole frame
+	size_t n = points.size();
+	cv::Point2f corners[] = { cv::Point2f(0, 0), cv::Point2f(size.width - 1, 0),
+			cv::Point2f(0, size.height - 1), cv::Point2f(size.width - 1, size.height - 1) };
+	for (int c = 0; c < 4; ++c) {
+		size_t best = 0;
+		float best_d = 1e30f;
+		for (size_t i = 0; i < n; ++i) {
+			cv::Point2f e = points[i] - corners[c];
+			if (e.dot(e) < best_d) {
+				best_d = e.dot(e);
+				best = i;
+			}
+		}
+		points.push_back(corners[c]);
+		flows.push_back(flows[best]);
+	}
+
+	// triangle list holds only coordinates, so vertices are found by their exact position
+	cv::Subdiv2D subdiv(frame);
+	index.clear();
+	for (size_t i = 0; i < points.size(); ++i) {
+		subdiv.insert(points[i]);
+		index[std::make_pair(points[i].x, points[i].y)] = i;
+	}
+	subdiv.getTriangleList(triangles);
+
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		const cv::Vec6f & tr = triangles[t];
+		int v[3];
+		bool valid = true;
+		for (int k = 0; k < 3 && valid; ++k) {
+			std::map<std::pair<float, float>, int>::const_iterator it = index.find(std::make_pair(tr[2 * k], tr[2 * k + 1]));
+			if (it == index.end())
+				valid = false;
+			else
+				v[k] = it->second;
+		}
+		// triangles touching virtual outer vertices of subdivision are skipped
+		if (!valid)
+			continue;
+
+		rasterize(flow, points[v[0]], points[v[1]], points[v[2]], flows[v[0]], flows[v[1]], flows[v[2]]);
+	}
+
+	out_flow.write(flow);
+}
+
+void SparseToDenseFlow::rasterize(cv::Mat & flow, cv::Point2f a, cv::Point2f b, cv::Point2f c,
+		cv::Point2f fa, cv::Point2f fb, cv::Point2f fc) {
+	float d = (b - a).cross(c - a);
+	if (std::fabs(d) < 1e-6f)
+		return;
+	float inv = 1.0f / d;
+
+	int x0 = std::max(0, (int) std::floor(std::min(a.x, std::min(b.x, c.x))));
+	int x1 = std::min(flow.cols - 1, (int) std::ceil(std::max(a.x, std::max(b.x, c.x))));
+	int y0 = std::max(0, (int) std::floor(std::min(a.y, std::min(b.y, c.y))));
+	int y1 = std::min(flow.rows - 1, (int) std::ceil(std::max(a.y, std::max(b.y, c.y))));
+
+	// barycentric coordinates are affine in x, so they are updated incrementally along rows
+	const float eps = -1e-4f;
+	for (int y = y0; y <= y1; ++y) {
+		cv::Point2f p(x0, y);
+		float wa = (b - p).cross(c - p) * inv;
+		float wb = (c - p).cross(a - p) * inv;
+		float dwa = (b.y - c.y) * inv;
+		float dwb = (c.y - a.y) * inv;
+
+		cv::Vec2f * row = flow.ptr<cv::Vec2f>(y);
+		for (int x = x0; x <= x1; ++x, wa += dwa, wb += dwb) {
+			float wc = 1 - wa - wb;
+			if (wa < eps || wb < eps || wc < eps)
+				continue;
+			row[x][0] = wa * fa.x + wb * fb.x + wc * fc.x;
+			row[x][1] = wa * fa.y + wb * fb.y + wc * fc.y;
+		}
+	}
+}
+
+
+
+} //: namespace SparseToDenseFlow
+} //: namespace Processors
@@ -0,0 +1,118 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef SPARSETODENSEFLOW_HPP_
+#define SPARSETODENSEFLOW_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <map>
+
+
+namespace Processors {
+namespace SparseToDenseFlow {
+
+/*!
+ * \class SparseToDenseFlow
+ * \brief SparseToDenseFlow processor class.
+ *
+ * Approximates dense optical flow from sparse point tracks (e.g. from
+ * OpticalFlowLK). Track start points are triangulated (Delaunay) and flow
+ * inside each triangle is interpolated linearly from its vertices, which gives
+ * piecewise-affine motion field. Image corners are added to triangulation with
+ * flow of the nearest track, so the whole frame is covered. Output has the same
+ * format as OpticalFlowFarneback (CV_32FC2, displacement of previous frame pixels).
+ */
+class SparseToDenseFlow: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	SparseToDenseFlow(const std::string & name = "SparseToDenseFlow");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~SparseToDenseFlow();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<std::vector<cv::Vec4f> > in_tracks;
+	/// Image is used only to get size of the output field
+	Base::DataStreamIn<cv::Mat> in_img;
+
+	// Output data streams
+	Base::DataStreamOut<cv::Mat> out_flow;
+
+	// Handlers
+
+	// Properties
+	Base::Property<int> max_flow;
+
+
+	// Handlers
+	void onNewTracks();
+
+	/*!
+	 * Fills triangle abc of flow field with linear interpolation of vertex flows.
+	 */
+	void rasterize(cv::Mat & flow, cv::Point2f a, cv::Point2f b, cv::Point2f c,
+			cv::Point2f fa, cv::Point2f fb, cv::Point2f fc);
+
+	/// Size of the output field, taken from the last image
+	cv::Size size;
+
+	/// Triangulation vertices and their flow, reused between frames
+	std::vector<cv::Point2f> points;
+	std::vector<cv::Point2f> flows;
+	std::vector<cv::Vec6f> triangles;
+	std::map<std::pair<float, float>, int> index;
+};
+
+} //: namespace SparseToDenseFlow
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("SparseToDenseFlow", Processors::SparseToDenseFlow::SparseToDenseFlow)
+
+#endif /* SPARSETODENSEFLOW_HPP_ */
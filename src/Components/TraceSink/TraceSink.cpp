@@ -0,0 +1,98 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+
+#include "TraceSink.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace TraceSink {
+
+TraceSink::TraceSink(const std::string & name) :
+		Base::Component(name),
+		file("file", std::string("trace.json")),
+		capacity("capacity", 65536, "range"),
+		period("period", 0, "range") {
+
+	registerProperty(file);
+	
+	// number of events kept in the ring buffer (older are overwritten)
+	capacity.addConstraint("1024");
+	capacity.addConstraint("4194304");
+	registerProperty(capacity);
+	
+	// interval between periodic dumps in seconds, 0 - only on stop
+	period.addConstraint("0");
+	period.addConstraint("3600");
+	registerProperty(period);
+	
+	trace_stage = -1;
+	last_dump = 0;
+}
+
+TraceSink::~TraceSink() {
+}
+
+void TraceSink::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_stamp", &in_stamp);
+	registerStream("out_latency", &out_latency);
+	// Register handlers
+	registerHandler("onStamp", boost::bind(&TraceSink::onStamp, this));
+	addDependency("onStamp", &in_stamp);
+	registerHandler("dump", boost::bind(&TraceSink::dump, this));
+
+}
+
+bool TraceSink::onInit() {
+	trace_stage = Types::Trace::stage("latency");
+	return true;
+}
+
+bool TraceSink::onFinish() {
+	return true;
+}
+
+bool TraceSink::onStop() {
+	Types::Trace::disable();
+	dump();
+	return true;
+}
+
+bool TraceSink::onStart() {
+	Types::Trace::enable(capacity);
+	last_dump = Types::Trace::now();
+	return true;
+}
+
+void TraceSink::onStamp() {
+	Types::Stamp stamp = in_stamp.read();
+	double now = Types::Trace::now();
+	
+	Types::Trace::record(trace_stage, stamp, stamp.capture, now);
+	out_latency.write(1e3 * (now - stamp.capture));
+	
+	if (period > 0 && now - last_dump > period) {
+		dump();
+		last_dump = now;
+	}
+}
+
+void TraceSink::dump() {
+	if (!Types::Trace::dumpChrome(file))
+		CLOG(LERROR) << "TraceSink: can't write " << std::string(file);
+	else
+		CLOG(LDEBUG) << "TraceSink: trace written to " << std::string(file);
+}
+
+
+
+} //: namespace TraceSink
+} //: namespace Processors
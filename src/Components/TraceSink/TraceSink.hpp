@@ -0,0 +1,110 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef TRACESINK_HPP_
+#define TRACESINK_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+
+
+namespace Processors {
+namespace TraceSink {
+
+/*!
+ * \class TraceSink
+ * \brief TraceSink processor class.
+ *
+ * Enables recording of stage timings (see Types::Trace) for the whole process
+ * and writes them in Chrome trace event format on stop, on "dump" event and
+ * periodically. Stamps received on in_stamp (usually from the last component
+ * of the pipeline) close the frame - capture to arrival time is recorded as
+ * separate "latency" stage and published on out_latency.
+ */
+class TraceSink: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	TraceSink(const std::string & name = "TraceSink");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~TraceSink();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<Types::Stamp> in_stamp;
+
+	// Output data streams
+	/// Capture to arrival time of the last stamp, in milliseconds
+	Base::DataStreamOut<double> out_latency;
+
+	// Handlers
+
+	// Properties
+	Base::Property<std::string> file;
+	Base::Property<int> capacity;
+	Base::Property<int> period;
+
+
+	// Handlers
+	void onStamp();
+	void dump();
+
+	/// Stage id of end-to-end latency events
+	int trace_stage;
+	/// Time of last periodic dump (seconds)
+	double last_dump;
+};
+
+} //: namespace TraceSink
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("TraceSink", Processors::TraceSink::TraceSink)
+
+#endif /* TRACESINK_HPP_ */
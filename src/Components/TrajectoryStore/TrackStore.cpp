@@ -0,0 +1,374 @@
+/*!
+ * \file
+ * \brief Bounded in-memory history of tracks with spatial and time index
+ * \author Maciej Stefańczyk
+ */
+
+#include "TrackStore.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Processors {
+namespace TrajectoryStore {
+
+namespace {
+
+/// Cell coordinates are clamped, so that far outliers don't overflow
+const int max_cell = 1 << 20;
+
+int clampCell(double c) {
+	return (int) std::max<double>(-max_cell, std::min<double>(max_cell, std::floor(c)));
+}
+
+bool closer(const TrackStore::Neighbour & a, const TrackStore::Neighbour & b) {
+	return a.distance < b.distance;
+}
+
+} //: namespace
+
+TrackStore::TrackStore(float cell) : cell_size(cell), max_chunks(0), query(0) {
+	clear();
+}
+
+void TrackStore::clear() {
+	pool.clear();
+	free_chunks.clear();
+	queue.clear();
+	track_map.clear();
+	grid.clear();
+	marks.clear();
+	cx_min = cy_min = max_cell;
+	cx_max = cy_max = -max_cell;
+	now = 0;
+}
+
+void TrackStore::setCell(float cell) {
+	cell = std::max(cell, 1.0f);
+	if (cell == cell_size)
+		return;
+	cell_size = cell;
+	clear();
+}
+
+void TrackStore::setBudget(std::size_t bytes) {
+	max_chunks = bytes ? std::max<std::size_t>(bytes / sizeof(Chunk), 1) : 0;
+	while (max_chunks && queue.size() > max_chunks)
+		evictOldest();
+}
+
+int64_t TrackStore::cellOf(float x, float y) const {
+	return cellKey(clampCell(x / cell_size), clampCell(y / cell_size));
+}
+
+void TrackStore::add(Key key, const Types::Track & t) {
+	if (t.x != t.x || t.y != t.y)
+		return;
+
+	now = std::max(now, t.timestamp);
+
+	// new chunk is taken before entry is referenced, as it may evict chunks of this very track
+	TrackMap::iterator it = track_map.find(key);
+	if (it == track_map.end() || pool[it->second.chunks.back()].count == Chunk::Capacity) {
+		int ci = allocChunk(key);
+		it = track_map.find(key);
+		if (it == track_map.end())
+			it = track_map.insert(std::make_pair(key, TrackEntry())).first;
+		it->second.chunks.push_back(ci);
+	}
+
+	int ci = it->second.chunks.back();
+	Chunk & c = pool[ci];
+	int i = c.count++;
+	c.t[i] = t.timestamp;
+	c.x[i] = t.x;
+	c.y[i] = t.y;
+	c.vx[i] = t.vx;
+	c.vy[i] = t.vy;
+	c.r[i] = t.r;
+
+	if (i == 0) {
+		c.t_first = c.t_last = t.timestamp;
+		c.x_min = c.x_max = t.x;
+		c.y_min = c.y_max = t.y;
+	} else {
+		c.t_last = std::max(c.t_last, t.timestamp);
+		c.x_min = std::min(c.x_min, t.x);
+		c.x_max = std::max(c.x_max, t.x);
+		c.y_min = std::min(c.y_min, t.y);
+		c.y_max = std::max(c.y_max, t.y);
+	}
+
+	// consecutive samples usually stay in the same cell
+	int64_t cell = cellOf(t.x, t.y);
+	if (c.cells.empty() || (c.cells.back() != cell && std::find(c.cells.begin(), c.cells.end(), cell) == c.cells.end())) {
+		c.cells.push_back(cell);
+		grid[cell].push_back(ci);
+
+		int cx = (int) (cell >> 32), cy = (int32_t) (cell & 0xffffffff);
+		cx_min = std::min(cx_min, cx);
+		cx_max = std::max(cx_max, cx);
+		cy_min = std::min(cy_min, cy);
+		cy_max = std::max(cy_max, cy);
+	}
+
+	it->second.last = t;
+}
+
+void TrackStore::evict(double max_age) {
+	if (max_age <= 0)
+		return;
+
+	// queue is ordered by creation, chunk still being filled stops eviction of younger ones
+	while (!queue.empty() && pool[queue.front()].t_last < now - max_age)
+		evictOldest();
+}
+
+int TrackStore::allocChunk(Key key) {
+	while (max_chunks && queue.size() >= max_chunks)
+		evictOldest();
+
+	int ci;
+	if (!free_chunks.empty()) {
+		ci = free_chunks.back();
+		free_chunks.pop_back();
+	} else {
+		pool.push_back(Chunk());
+		marks.push_back(0);
+		ci = pool.size() - 1;
+	}
+
+	Chunk & c = pool[ci];
+	c.key = key;
+	c.count = 0;
+	c.t_first = c.t_last = 0;
+	c.cells.clear();
+
+	queue.push_back(ci);
+	return ci;
+}
+
+void TrackStore::evictOldest() {
+	int ci = queue.front();
+	queue.pop_front();
+	Chunk & c = pool[ci];
+
+	for (std::size_t i = 0; i < c.cells.size(); ++i) {
+		std::vector<int> & v = grid[c.cells[i]];
+		std::vector<int>::iterator it = std::find(v.begin(), v.end(), ci);
+		if (it != v.end()) {
+			*it = v.back();
+			v.pop_back();
+		}
+	}
+	c.cells.clear();
+
+	// oldest chunk of any track is the first one of its own chunks
+	TrackMap::iterator it = track_map.find(c.key);
+	if (it != track_map.end()) {
+		std::deque<int> & chunks = it->second.chunks;
+		if (!chunks.empty() && chunks.front() == ci)
+			chunks.pop_front();
+		else
+			chunks.erase(std::remove(chunks.begin(), chunks.end(), ci), chunks.end());
+		if (chunks.empty())
+			track_map.erase(it);
+	}
+
+	c.count = 0;
+	free_chunks.push_back(ci);
+}
+
+void TrackStore::collect(int cx, int cy, std::vector<int> & candidates) {
+	Grid::const_iterator g = grid.find(cellKey(cx, cy));
+	if (g == grid.end())
+		return;
+	for (std::size_t i = 0; i < g->second.size(); ++i) {
+		int ci = g->second[i];
+		if (marks[ci] != query) {
+			marks[ci] = query;
+			candidates.push_back(ci);
+		}
+	}
+}
+
+Types::Track TrackStore::sample(const Chunk & c, int i) const {
+	Types::Track t;
+	t.timestamp = c.t[i];
+	t.id = (uint32_t) c.key;
+	t.lost = 0;
+	t.x = c.x[i];
+	t.y = c.y[i];
+	t.r = c.r[i];
+	t.vx = c.vx[i];
+	t.vy = c.vy[i];
+	return t;
+}
+
+void TrackStore::region(const cv::Rect_<float> & r, double since, std::vector<Key> & res) {
+	res.clear();
+	if (queue.empty() || r.width <= 0 || r.height <= 0)
+		return;
+
+	if (++query == 0) {
+		std::fill(marks.begin(), marks.end(), 0);
+		query = 1;
+	}
+
+	int x0 = std::max(cx_min, clampCell(r.x / cell_size));
+	int x1 = std::min(cx_max, clampCell((r.x + r.width) / cell_size));
+	int y0 = std::max(cy_min, clampCell(r.y / cell_size));
+	int y1 = std::min(cy_max, clampCell((r.y + r.height) / cell_size));
+	if (x1 < x0 || y1 < y0)
+		return;
+
+	// for regions covering most of the grid scanning all chunks is cheaper
+	std::vector<int> candidates;
+	if ((double) (x1 - x0 + 1) * (y1 - y0 + 1) > queue.size()) {
+		candidates.assign(queue.begin(), queue.end());
+	} else {
+		for (int cy = y0; cy <= y1; ++cy)
+			for (int cx = x0; cx <= x1; ++cx)
+				collect(cx, cy, candidates);
+	}
+
+	for (std::size_t k = 0; k < candidates.size(); ++k) {
+		const Chunk & c = pool[candidates[k]];
+		if (c.t_last < since || c.x_max < r.x || c.y_max < r.y || c.x_min >= r.x + r.width || c.y_min >= r.y + r.height)
+			continue;
+		for (int i = 0; i < c.count; ++i) {
+			if (c.t[i] >= since && r.contains(cv::Point2f(c.x[i], c.y[i]))) {
+				res.push_back(c.key);
+				break;
+			}
+		}
+	}
+
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+}
+
+void TrackStore::nearest(const cv::Point2f & p, int k, double since, std::vector<Neighbour> & res) {
+	res.clear();
+	if (queue.empty() || k <= 0)
+		return;
+
+	if (++query == 0) {
+		std::fill(marks.begin(), marks.end(), 0);
+		query = 1;
+	}
+
+	// closest sample (squared distance, chunk, index) of every track seen so far
+	typedef boost::unordered_map<Key, std::pair<float, std::pair<int, int> > > Best;
+	Best best;
+
+	int pcx = clampCell(p.x / cell_size);
+	int pcy = clampCell(p.y / cell_size);
+
+	// rings of cells around p are searched until k tracks are closer than unvisited cells,
+	// sparse grids are scanned chunk by chunk instead
+	int first = std::max(std::max(cx_min - pcx, pcx - cx_max), std::max(cy_min - pcy, pcy - cy_max));
+	first = std::max(first, 0);
+	double cells = (double) (cx_max - cx_min + 1) * (cy_max - cy_min + 1);
+	bool scan_all = cells > 4.0 * queue.size();
+
+	std::vector<int> candidates;
+	for (int ring = first; ; ++ring) {
+		candidates.clear();
+		if (scan_all) {
+			candidates.assign(queue.begin(), queue.end());
+		} else {
+			for (int cy = std::max(pcy - ring, cy_min); cy <= std::min(pcy + ring, cy_max); ++cy) {
+				if (cy == pcy - ring || cy == pcy + ring) {
+					for (int cx = std::max(pcx - ring, cx_min); cx <= std::min(pcx + ring, cx_max); ++cx)
+						collect(cx, cy, candidates);
+				} else {
+					if (pcx - ring >= cx_min)
+						collect(pcx - ring, cy, candidates);
+					if (pcx + ring <= cx_max)
+						collect(pcx + ring, cy, candidates);
+				}
+			}
+		}
+
+		for (std::size_t j = 0; j < candidates.size(); ++j) {
+			const Chunk & c = pool[candidates[j]];
+			if (c.t_last < since)
+				continue;
+			std::pair<float, std::pair<int, int> > b(-1, std::make_pair(candidates[j], 0));
+			for (int i = 0; i < c.count; ++i) {
+				if (c.t[i] < since)
+					continue;
+				float dx = c.x[i] - p.x, dy = c.y[i] - p.y;
+				float d = dx * dx + dy * dy;
+				if (b.first < 0 || d < b.first) {
+					b.first = d;
+					b.second.second = i;
+				}
+			}
+			if (b.first < 0)
+				continue;
+			Best::iterator it = best.find(c.key);
+			if (it == best.end())
+				best.insert(std::make_pair(c.key, b));
+			else if (b.first < it->second.first)
+				it->second = b;
+		}
+
+		if (scan_all)
+			break;
+
+		// every sample outside of visited rings is at least ring cells away
+		if ((int) best.size() >= k) {
+			std::vector<float> d;
+			d.reserve(best.size());
+			for (Best::const_iterator it = best.begin(); it != best.end(); ++it)
+				d.push_back(it->second.first);
+			std::nth_element(d.begin(), d.begin() + (k - 1), d.end());
+			float limit = ring * cell_size;
+			if (d[k - 1] <= limit * limit)
+				break;
+		}
+
+		if (pcx - ring <= cx_min && pcx + ring >= cx_max && pcy - ring <= cy_min && pcy + ring >= cy_max)
+			break;
+	}
+
+	res.reserve(best.size());
+	for (Best::const_iterator it = best.begin(); it != best.end(); ++it) {
+		Neighbour n;
+		n.distance = std::sqrt(it->second.first);
+		n.key = it->first;
+		n.track = sample(pool[it->second.second.first], it->second.second.second);
+		res.push_back(n);
+	}
+	std::sort(res.begin(), res.end(), closer);
+	if ((int) res.size() > k)
+		res.resize(k);
+}
+
+bool TrackStore::last(Key key, Types::Track & t) const {
+	TrackMap::const_iterator it = track_map.find(key);
+	if (it == track_map.end())
+		return false;
+	t = it->second.last;
+	return true;
+}
+
+std::size_t TrackStore::tracks() const {
+	return track_map.size();
+}
+
+std::size_t TrackStore::samples() const {
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < queue.size(); ++i)
+		n += pool[queue[i]].count;
+	return n;
+}
+
+std::size_t TrackStore::memory() const {
+	return queue.size() * sizeof(Chunk);
+}
+
+} //: namespace TrajectoryStore
+} //: namespace Processors
@@ -0,0 +1,197 @@
+/*!
+ * \file
+ * \brief Bounded in-memory history of tracks with spatial and time index
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef TRACKSTORE_HPP_
+#define TRACKSTORE_HPP_
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include <opencv2/opencv.hpp>
+
+#include "Types/Track.hpp"
+
+namespace Processors {
+namespace TrajectoryStore {
+
+/*!
+ * \class TrackStore
+ * \brief History of track positions, queryable by region, time and distance.
+ *
+ * Samples of every track are kept in fixed-size chunks, each chunk stores
+ * consecutive samples column by column (times, positions, velocities), so
+ * queries scan contiguous arrays. Chunks come from a pool and are recycled,
+ * after warm-up adding samples doesn't allocate.
+ *
+ * Chunks are indexed in uniform grid (chunk is listed in every cell its
+ * samples fall into) and queued in creation order, which is the time index
+ * used for eviction: oldest chunks are dropped when they are older than
+ * maximal age or when memory budget is exceeded.
+ *
+ * Times are data times (Track::timestamp), "now" is the newest sample seen.
+ */
+class TrackStore {
+public:
+	/// Track key, source in upper and track id in lower 32 bits
+	typedef uint64_t Key;
+
+	/*!
+	 * \struct Neighbour
+	 * \brief Query result - track, its state at closest sample and distance to query point.
+	 */
+	struct Neighbour {
+		float distance;
+		Key key;
+		Types::Track track;
+	};
+
+	/*!
+	 * \param cell grid cell size in pixels
+	 */
+	TrackStore(float cell = 32);
+
+	static Key key(uint32_t source, uint32_t id) {
+		return ((Key) source << 32) | id;
+	}
+
+	/// Source part of the key, Track::id holds only the id part
+	static uint32_t source(Key key) {
+		return (uint32_t) (key >> 32);
+	}
+
+	/*!
+	 * Removes all samples.
+	 */
+	void clear();
+
+	/*!
+	 * Sets grid cell size, clears the store if it changes.
+	 */
+	void setCell(float cell);
+
+	/*!
+	 * Sets maximal number of bytes used by samples, 0 - unlimited.
+	 */
+	void setBudget(std::size_t bytes);
+
+	/*!
+	 * Appends sample to the track, samples of each track have to come in time order.
+	 */
+	void add(Key key, const Types::Track & t);
+
+	/*!
+	 * Drops samples older than max_age seconds before newest one.
+	 */
+	void evict(double max_age);
+
+	/*!
+	 * Finds tracks with at least one sample inside region since given time.
+	 * \param res keys of found tracks (sorted)
+	 */
+	void region(const cv::Rect_<float> & r, double since, std::vector<Key> & res);
+
+	/*!
+	 * Finds k tracks with samples closest to p since given time.
+	 * \param res found tracks, closest first
+	 */
+	void nearest(const cv::Point2f & p, int k, double since, std::vector<Neighbour> & res);
+
+	/*!
+	 * Last sample of the track.
+	 * \returns false if track isn't stored
+	 */
+	bool last(Key key, Types::Track & t) const;
+
+	/// Time of the newest sample
+	double newest() const {
+		return now;
+	}
+
+	/// Number of stored tracks and samples, bytes used by chunks
+	std::size_t tracks() const;
+	std::size_t samples() const;
+	std::size_t memory() const;
+
+private:
+	/*!
+	 * \struct Chunk
+	 * \brief Consecutive samples of single track, stored column-wise.
+	 */
+	struct Chunk {
+		enum { Capacity = 64 };
+
+		Key key;
+		int count;
+		/// Time and bounding box of samples
+		double t_first, t_last;
+		float x_min, y_min, x_max, y_max;
+		/// Cells chunk is listed in
+		std::vector<int64_t> cells;
+
+		double t[Capacity];
+		float x[Capacity];
+		float y[Capacity];
+		float vx[Capacity];
+		float vy[Capacity];
+		float r[Capacity];
+	};
+
+	struct TrackEntry {
+		/// Chunks of the track, oldest first
+		std::deque<int> chunks;
+		Types::Track last;
+	};
+
+	typedef boost::unordered_map<Key, TrackEntry> TrackMap;
+	typedef boost::unordered_map<int64_t, std::vector<int> > Grid;
+
+	int64_t cellOf(float x, float y) const;
+
+	int64_t cellKey(int cx, int cy) const {
+		return ((int64_t) cx << 32) | (uint32_t) cy;
+	}
+
+	/// Takes chunk from pool, evicting oldest one if budget is exhausted
+	int allocChunk(Key key);
+
+	/// Removes oldest chunk from grid, its track and the time queue
+	void evictOldest();
+
+	/// Appends chunks of the cell not visited yet in current query
+	void collect(int cx, int cy, std::vector<int> & candidates);
+
+	/// Sample i of chunk as track state, with id of the track within its source
+	Types::Track sample(const Chunk & c, int i) const;
+
+	float cell_size;
+	std::size_t max_chunks;
+
+	std::vector<Chunk> pool;
+	std::vector<int> free_chunks;
+	/// Chunks in creation order
+	std::deque<int> queue;
+
+	TrackMap track_map;
+	Grid grid;
+	/// Range of cells that ever had samples
+	int cx_min, cy_min, cx_max, cy_max;
+
+	double now;
+
+	/// Visit marks of chunks in current query
+	std::vector<unsigned> marks;
+	unsigned query;
+};
+
+} //: namespace TrajectoryStore
+} //: namespace Processors
+
+#endif /* TRACKSTORE_HPP_ */
@@ -0,0 +1,202 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#include <memory>
+#include <string>
+
+#include "TrajectoryStore.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace TrajectoryStore {
+
+namespace {
+
+/// Sources of tracks, each input keeps its own id space, values are published in out_*_source
+enum Source {
+	SourceTrackSet = 0,
+	SourceTrack = 1,
+	SourcePred = 2
+};
+
+} //: namespace
+
+TrajectoryStore::TrajectoryStore(const std::string & name) :
+		Base::Component(name),
+		max_age("max_age", 60, "range"),
+		memory("memory", 64, "range"),
+		cell("cell", 32, "range"),
+		window("window", 5, "range"),
+		k("k", 5, "range") {
+
+	// samples older than that (in seconds) are dropped, 0 - only memory limit applies
+	max_age.addConstraint("0");
+	max_age.addConstraint("86400");
+	registerProperty(max_age);
+
+	// memory budget of samples in MB, oldest are dropped when it's exceeded, 0 - unlimited
+	memory.addConstraint("0");
+	memory.addConstraint("4096");
+	registerProperty(memory);
+
+	// size of spatial index cell in pixels, change clears the history
+	cell.addConstraint("4");
+	cell.addConstraint("512");
+	registerProperty(cell);
+
+	// queries take into account last window seconds, 0 - whole history
+	window.addConstraint("0");
+	window.addConstraint("3600");
+	registerProperty(window);
+
+	// number of tracks returned by nearest tracks query
+	k.addConstraint("1");
+	k.addConstraint("100");
+	registerProperty(k);
+
+	result.clear();
+	trace_stage = -1;
+	stamp_seq = 0;
+}
+
+TrajectoryStore::~TrajectoryStore() {
+}
+
+void TrajectoryStore::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_trackset", &in_trackset);
+	registerStream("in_track", &in_track);
+	registerStream("in_pred", &in_pred);
+	registerStream("in_stamp", &in_stamp);
+	registerStream("in_region", &in_region);
+	registerStream("in_point", &in_point);
+	registerStream("out_region", &out_region);
+	registerStream("out_nearest", &out_nearest);
+	registerStream("out_region_source", &out_region_source);
+	registerStream("out_nearest_source", &out_nearest_source);
+	// Register handlers
+	registerHandler("onTrackSet", boost::bind(&TrajectoryStore::onTrackSet, this));
+	addDependency("onTrackSet", &in_trackset);
+	registerHandler("onTrack", boost::bind(&TrajectoryStore::onTrack, this));
+	addDependency("onTrack", &in_track);
+	registerHandler("onPred", boost::bind(&TrajectoryStore::onPred, this));
+	addDependency("onPred", &in_pred);
+	registerHandler("onRegion", boost::bind(&TrajectoryStore::onRegion, this));
+	addDependency("onRegion", &in_region);
+	registerHandler("onPoint", boost::bind(&TrajectoryStore::onPoint, this));
+	addDependency("onPoint", &in_point);
+
+}
+
+bool TrajectoryStore::onInit() {
+	trace_stage = Types::Trace::stage(name());
+	store.setCell(cell);
+	return true;
+}
+
+bool TrajectoryStore::onFinish() {
+	return true;
+}
+
+bool TrajectoryStore::onStop() {
+	CLOG(LDEBUG) << "TrajectoryStore: " << store.tracks() << " tracks, " << store.samples() << " samples, "
+	             << store.memory() / 1024 << " kB";
+	return true;
+}
+
+bool TrajectoryStore::onStart() {
+	return true;
+}
+
+void TrajectoryStore::onTrackSet() {
+	const Types::TrackSet & ts = in_trackset.read();
+	Types::Trace::Scope trace(trace_stage, Types::Stamp::make(ts.timestamp, ts.id));
+
+	for (uint32_t i = 0; i < ts.count; ++i)
+		store.add(TrackStore::key(SourceTrackSet, ts.tracks[i].id), ts.tracks[i]);
+	maintain();
+}
+
+void TrajectoryStore::onTrack() {
+	Types::Track t = in_track.read();
+	store.add(TrackStore::key(SourceTrack, t.id), t);
+	maintain();
+}
+
+void TrajectoryStore::onPred() {
+	std::vector<float> pred = in_pred.read();
+	Types::Stamp stamp = Types::Trace::readStamp(in_stamp, stamp_seq);
+	if (pred.size() < 2) {
+		CLOG(LWARNING) << "TrajectoryStore: prediction has " << pred.size() << " elements, expected [x, y, r]";
+		return;
+	}
+
+	// predictions carry no id and velocity, they form single track
+	Types::Track t;
+	t.timestamp = stamp.capture;
+	t.id = 0;
+	t.lost = 0;
+	t.x = pred[0];
+	t.y = pred[1];
+	t.r = pred.size() > 2 ? pred[2] : 0;
+	t.vx = t.vy = 0;
+	store.add(TrackStore::key(SourcePred, 0), t);
+	maintain();
+}
+
+void TrajectoryStore::onRegion() {
+	cv::Rect r = in_region.read();
+	store.region(cv::Rect_<float>(r.x, r.y, r.width, r.height), since(), keys);
+
+	result.clear();
+	result.timestamp = store.newest();
+	result.id = 0;
+	sources.clear();
+	Types::Track t;
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		if (!store.last(keys[i], t))
+			continue;
+		if (!result.add(t))
+			break;
+		sources.push_back(TrackStore::source(keys[i]));
+	}
+	out_region_source.write(sources);
+	out_region.write(result);
+}
+
+void TrajectoryStore::onPoint() {
+	cv::Point2f p = in_point.read();
+	store.nearest(p, k, since(), neighbours);
+
+	result.clear();
+	result.timestamp = store.newest();
+	result.id = 0;
+	sources.clear();
+	for (std::size_t i = 0; i < neighbours.size(); ++i) {
+		if (!result.add(neighbours[i].track))
+			break;
+		sources.push_back(TrackStore::source(neighbours[i].key));
+	}
+	out_nearest_source.write(sources);
+	out_nearest.write(result);
+}
+
+void TrajectoryStore::maintain() {
+	store.setCell(cell);
+	store.setBudget((std::size_t) memory << 20);
+	store.evict(max_age);
+}
+
+double TrajectoryStore::since() {
+	return window > 0 ? store.newest() - window : -1e300;
+}
+
+
+
+} //: namespace TrajectoryStore
+} //: namespace Processors
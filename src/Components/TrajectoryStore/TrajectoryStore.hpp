@@ -0,0 +1,148 @@
+/*!
+ * \file
+ * \brief
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef TRAJECTORYSTORE_HPP_
+#define TRAJECTORYSTORE_HPP_
+
+#include "Base/Component_Aux.hpp"
+#include "Base/Component.hpp"
+#include "Base/DataStream.hpp"
+#include "Base/Property.hpp"
+#include "Base/EventHandler2.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include "Types/Track.hpp"
+#include "Types/Stamp.hpp"
+#include "Types/Trace.hpp"
+
+#include "TrackStore.hpp"
+
+
+namespace Processors {
+namespace TrajectoryStore {
+
+/*!
+ * \class TrajectoryStore
+ * \brief TrajectoryStore processor class.
+ *
+ * Keeps history of tracks received from trackers (LK tracksets, Kalman
+ * tracks and predictions) and answers queries about it: which tracks
+ * passed through a region in last window seconds (in_region -> out_region)
+ * and which tracks came closest to a point (in_point -> out_nearest).
+ * Each input is a separate source, tracks with equal ids from different
+ * inputs are stored separately. Reported tracks keep the id given by their
+ * source, the source itself (0 - in_trackset, 1 - in_track, 2 - in_pred) of
+ * each reported track is published alongside, in the same order.
+ */
+class TrajectoryStore: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	TrajectoryStore(const std::string & name = "TrajectoryStore");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~TrajectoryStore();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	/// Point tracks, e.g. OpticalFlowLK.out_trackset
+	Base::DataStreamIn<Types::TrackSet> in_trackset;
+	/// Single object track, e.g. Kalman.out_track
+	Base::DataStreamIn<Types::Track> in_track;
+	/// Predicted position [x, y, r] without id, e.g. Kalman.out_pred
+	Base::DataStreamIn<std::vector<float> > in_pred;
+	/// Time of in_pred (optional)
+	Base::DataStreamIn<Types::Stamp> in_stamp;
+	/// Region query
+	Base::DataStreamIn<cv::Rect> in_region;
+	/// Nearest tracks query
+	Base::DataStreamIn<cv::Point2f> in_point;
+
+	// Output data streams
+	/// Last state of tracks that visited queried region
+	Base::DataStreamOut<Types::TrackSet> out_region;
+	/// States of nearest tracks at their closest samples, closest first
+	Base::DataStreamOut<Types::TrackSet> out_nearest;
+	/// Sources of tracks in out_region and out_nearest
+	Base::DataStreamOut<std::vector<int> > out_region_source;
+	Base::DataStreamOut<std::vector<int> > out_nearest_source;
+
+	// Properties
+	Base::Property<int> max_age;
+	Base::Property<int> memory;
+	Base::Property<int> cell;
+	Base::Property<int> window;
+	Base::Property<int> k;
+
+
+	// Handlers
+	void onTrackSet();
+	void onTrack();
+	void onPred();
+	void onRegion();
+	void onPoint();
+
+	/// Applies properties and drops outdated samples
+	void maintain();
+
+	/// Start time of queries
+	double since();
+
+	TrackStore store;
+
+	/// Reused, so that queries don't allocate
+	Types::TrackSet result;
+	std::vector<int> sources;
+	std::vector<TrackStore::Key> keys;
+	std::vector<TrackStore::Neighbour> neighbours;
+
+	/// Trace stage id and number of the next prediction without stamp
+	int trace_stage;
+	uint32_t stamp_seq;
+};
+
+} //: namespace TrajectoryStore
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("TrajectoryStore", Processors::TrajectoryStore::TrajectoryStore)
+
+#endif /* TRAJECTORYSTORE_HPP_ */
@@ -0,0 +1,346 @@
+/*!
+ * \file
+ * \brief Offline accuracy vs speed tuner of optical flow parameters
+ * \author Maciej Stefańczyk
+ *
+ * Frame pairs with known flow are generated by warping input images (or
+ * procedural textures) with random affine transformations. Parameter space of
+ * OpticalFlowLK and OpticalFlowFarneback is swept, each configuration is scored
+ * with average endpoint error and processing time per frame, and configurations
+ * on the Pareto front are written as task XML parameter blocks.
+ *
+ * Usage: flow_tuner [--size WxH] [--pairs N] [--method lk|farneback|both] [--out file] [--seed N] [image ...]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace {
+
+/*!
+ * Frame pair with ground truth flow of the first frame.
+ */
+struct Sample {
+	cv::Mat prev, next;
+	/// Affine transformation mapping prev pixels to next
+	cv::Matx23d warp;
+	/// Ground truth flow (CV_32FC2) and mask of pixels that stay inside the frame
+	cv::Mat flow, valid;
+};
+
+/*!
+ * Single configuration with its score. Parameters are stored in property
+ * units, exactly as they are written to task file.
+ */
+struct Result {
+	std::string component;
+	std::vector<std::pair<std::string, std::string> > params;
+	double epe;
+	double ms;
+};
+
+/*!
+ * Random texture with structure on several scales, for runs without recorded images.
+ */
+cv::Mat proceduralImage(cv::Size size, cv::RNG & rng) {
+	cv::Mat img(size, CV_32F, cv::Scalar(0));
+	for (int s = 4; s <= 64; s *= 2) {
+		cv::Mat noise(size.height / s + 2, size.width / s + 2, CV_32F);
+		rng.fill(noise, cv::RNG::UNIFORM, 0, 1);
+		cv::Mat up;
+		cv::resize(noise, up, cv::Size(noise.cols * s, noise.rows * s), 0, 0, cv::INTER_CUBIC);
+		img += up(cv::Rect(0, 0, size.width, size.height)) * (s / 64.0);
+	}
+	cv::Mat out;
+	cv::normalize(img, img, 0, 255, cv::NORM_MINMAX);
+	img.convertTo(out, CV_8U);
+
+	// a few sharp edged shapes, so that not all texture is smooth
+	for (int i = 0; i < 20; ++i) {
+		cv::Point c(rng.uniform(0, size.width), rng.uniform(0, size.height));
+		int r = rng.uniform(5, size.width / 10 + 6);
+		cv::circle(out, c, r, cv::Scalar(rng.uniform(0, 256)), -1);
+	}
+	return out;
+}
+
+/*!
+ * Warps image with random small affine motion and computes ground truth flow.
+ */
+Sample makeSample(const cv::Mat & gray, cv::RNG & rng) {
+	Sample s;
+	s.prev = gray;
+
+	double angle = rng.uniform(-3.0, 3.0);
+	double scale = rng.uniform(0.97, 1.03);
+	double max_shift = 0.02 * gray.cols;
+	cv::Point2f center(gray.cols * 0.5f, gray.rows * 0.5f);
+	cv::Mat m = cv::getRotationMatrix2D(center, angle, scale);
+	m.at<double>(0, 2) += rng.uniform(-max_shift, max_shift);
+	m.at<double>(1, 2) += rng.uniform(-max_shift, max_shift);
+	s.warp = cv::Matx23d(m);
+
+	cv::warpAffine(gray, s.next, m, gray.size(), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+	// next(A x) = prev(x), so flow of prev pixel x is A x - x
+	s.flow.create(gray.size(), CV_32FC2);
+	s.valid.create(gray.size(), CV_8U);
+	cv::Rect frame(0, 0, gray.cols, gray.rows);
+	for (int y = 0; y < gray.rows; ++y) {
+		cv::Vec2f * f = s.flow.ptr<cv::Vec2f>(y);
+		uchar * v = s.valid.ptr<uchar>(y);
+		for (int x = 0; x < gray.cols; ++x) {
+			cv::Point2d p = s.warp * cv::Point3d(x, y, 1);
+			f[x] = cv::Vec2f(p.x - x, p.y - y);
+			v[x] = frame.contains(cv::Point((int) p.x, (int) p.y)) ? 255 : 0;
+		}
+	}
+	return s;
+}
+
+template <typename T>
+std::string str(T v) {
+	std::ostringstream ss;
+	ss << v;
+	return ss.str();
+}
+
+double median(std::vector<double> v) {
+	std::sort(v.begin(), v.end());
+	return v.empty() ? 0 : v[v.size() / 2];
+}
+
+/*!
+ * Evaluates LK tracker. Lost points count with error of zero-motion guess.
+ */
+Result evaluateLK(const std::vector<Sample> & samples, int window, int pyramids, int term_count, int term_eps) {
+	Result res;
+	res.component = "OpticalFlowLK";
+	res.params.push_back(std::make_pair("tracker.window", str(window)));
+	res.params.push_back(std::make_pair("tracker.pyramids", str(pyramids)));
+	res.params.push_back(std::make_pair("tracker.term_count", str(term_count)));
+	res.params.push_back(std::make_pair("tracker.term_eps", str(term_eps)));
+
+	// same detector and tracker settings as component defaults
+	cv::TermCriteria termcrit(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, term_count, 1e-3 * term_eps);
+	cv::Size winSize(window * 2 + 1, window * 2 + 1);
+
+	double err = 0;
+	int count = 0;
+	std::vector<double> times;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const Sample & s = samples[i];
+		std::vector<cv::Point2f> p0, p1;
+		cv::goodFeaturesToTrack(s.prev, p0, 100, 1e-2, 10, s.valid, 3, false, 0.04);
+		if (p0.empty())
+			continue;
+
+		std::vector<uchar> status;
+		std::vector<float> e;
+		int64 t0 = cv::getTickCount();
+		cv::calcOpticalFlowPyrLK(s.prev, s.next, p0, p1, status, e, winSize, pyramids, termcrit, 0, 1e-4 * 10);
+		times.push_back(1000.0 * (cv::getTickCount() - t0) / cv::getTickFrequency());
+
+		for (size_t k = 0; k < p0.size(); ++k) {
+			cv::Point2d gt = s.warp * cv::Point3d(p0[k].x, p0[k].y, 1);
+			cv::Point2d d = status[k] ? cv::Point2d(p1[k]) - gt : cv::Point2d(p0[k]) - gt;
+			err += std::sqrt(d.dot(d));
+			++count;
+		}
+	}
+
+	res.epe = count > 0 ? err / count : 1e9;
+	res.ms = median(times);
+	return res;
+}
+
+/*!
+ * Evaluates Farneback flow, including decimation used by the component.
+ */
+Result evaluateFarneback(const std::vector<Sample> & samples, int levels, int window, int iterations, int poly_n, int scale) {
+	int poly_sigma = poly_n == 5 ? 11 : 15;
+
+	Result res;
+	res.component = "OpticalFlowFarneback";
+	res.params.push_back(std::make_pair("pyr_scale", str(5)));
+	res.params.push_back(std::make_pair("levels", str(levels)));
+	res.params.push_back(std::make_pair("window", str(window)));
+	res.params.push_back(std::make_pair("iterations", str(iterations)));
+	res.params.push_back(std::make_pair("poly_n", str(poly_n)));
+	res.params.push_back(std::make_pair("poly_sigma", str(poly_sigma)));
+	res.params.push_back(std::make_pair("scale", str(scale)));
+
+	double err = 0;
+	std::vector<double> times;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const Sample & s = samples[i];
+		double f = 0.1 * scale;
+
+		int64 t0 = cv::getTickCount();
+		cv::Mat prev = s.prev, next = s.next, flow;
+		if (scale < 10) {
+			cv::resize(s.prev, prev, cv::Size(), f, f, cv::INTER_AREA);
+			cv::resize(s.next, next, cv::Size(), f, f, cv::INTER_AREA);
+		}
+		cv::calcOpticalFlowFarneback(prev, next, flow, 0.5, levels, window, iterations, poly_n, 0.1 * poly_sigma, 0);
+		if (scale < 10) {
+			double fx = (double) s.prev.cols / flow.cols, fy = (double) s.prev.rows / flow.rows;
+			cv::resize(flow, flow, s.prev.size(), 0, 0, cv::INTER_LINEAR);
+			cv::multiply(flow, cv::Scalar(fx, fy), flow);
+		}
+		times.push_back(1000.0 * (cv::getTickCount() - t0) / cv::getTickFrequency());
+
+		cv::Mat diff = flow - s.flow, mag;
+		std::vector<cv::Mat> c;
+		cv::split(diff, c);
+		cv::magnitude(c[0], c[1], mag);
+		err += cv::mean(mag, s.valid)[0];
+	}
+
+	res.epe = samples.empty() ? 1e9 : err / samples.size();
+	res.ms = median(times);
+	return res;
+}
+
+bool fasterThan(const Result & a, const Result & b) {
+	return a.ms < b.ms || (a.ms == b.ms && a.epe < b.epe);
+}
+
+/*!
+ * Configurations not dominated by any faster one.
+ */
+std::vector<Result> paretoFront(std::vector<Result> results) {
+	std::vector<Result> front;
+	std::sort(results.begin(), results.end(), fasterThan);
+	double best = 1e30;
+	for (size_t i = 0; i < results.size(); ++i) {
+		if (results[i].epe < best) {
+			best = results[i].epe;
+			front.push_back(results[i]);
+		}
+	}
+	return front;
+}
+
+void writeXml(std::ostream & os, const std::vector<Result> & front, cv::Size size) {
+	os << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+	os << "<!-- Pareto-optimal optical flow configurations for " << size.width << "x" << size.height << " -->\n";
+	os << "<Configurations>\n";
+	for (size_t i = 0; i < front.size(); ++i) {
+		const Result & r = front[i];
+		os << "\t<!-- EPE " << r.epe << " px, " << r.ms << " ms/frame -->\n";
+		os << "\t<Component name=\"OptFlow\" type=\"Tracking:" << r.component << "\">\n";
+		for (size_t k = 0; k < r.params.size(); ++k)
+			os << "\t\t<param name=\"" << r.params[k].first << "\">" << r.params[k].second << "</param>\n";
+		os << "\t</Component>\n";
+	}
+	os << "</Configurations>\n";
+}
+
+void usage(const char * name) {
+	std::cerr << "Usage: " << name << " [--size WxH] [--pairs N] [--method lk|farneback|both] [--out file] [--seed N] [image ...]\n";
+}
+
+} //: namespace
+
+int main(int argc, char * argv[]) {
+	cv::Size size(640, 480);
+	int pairs = 8;
+	std::string method = "both";
+	std::string out_file;
+	int seed = 0;
+	std::vector<std::string> images;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--size" && has_value) {
+			if (std::sscanf(argv[++i], "%dx%d", &size.width, &size.height) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (arg == "--pairs" && has_value) {
+			pairs = std::max(1, std::atoi(argv[++i]));
+		} else if (arg == "--method" && has_value) {
+			method = argv[++i];
+		} else if (arg == "--out" && has_value) {
+			out_file = argv[++i];
+		} else if (arg == "--seed" && has_value) {
+			seed = std::atoi(argv[++i]);
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			usage(argv[0]);
+			return 1;
+		} else {
+			images.push_back(arg);
+		}
+	}
+
+	// frame pairs at target resolution, recorded images are used in turns
+	cv::RNG rng(seed);
+	std::vector<Sample> samples;
+	for (int i = 0; i < pairs; ++i) {
+		cv::Mat gray;
+		if (!images.empty()) {
+			cv::Mat img = cv::imread(images[i % images.size()], cv::IMREAD_GRAYSCALE);
+			if (img.empty()) {
+				std::cerr << "Can't read " << images[i % images.size()] << "\n";
+				return 1;
+			}
+			cv::resize(img, gray, size, 0, 0, cv::INTER_AREA);
+		} else {
+			gray = proceduralImage(size, rng);
+		}
+		samples.push_back(makeSample(gray, rng));
+	}
+
+	std::vector<Result> lk, fb;
+	if (method == "lk" || method == "both") {
+		const int windows[] = { 5, 10, 15, 20 };
+		for (int w = 0; w < 4; ++w)
+			for (int p = 1; p <= 4; ++p)
+				for (int c = 10; c <= 30; c += 20)
+					for (int e = 10; e <= 30; e += 20) {
+						lk.push_back(evaluateLK(samples, windows[w], p, c, e));
+						std::cerr << "." << std::flush;
+					}
+	}
+	if (method == "farneback" || method == "both") {
+		const int windows[] = { 9, 15, 21 };
+		const int scales[] = { 10, 7, 5 };
+		for (int l = 2; l <= 4; ++l)
+			for (int w = 0; w < 3; ++w)
+				for (int it = 2; it <= 4; it += 2)
+					for (int n = 5; n <= 7; n += 2)
+						for (int s = 0; s < 3; ++s) {
+							fb.push_back(evaluateFarneback(samples, l, windows[w], it, n, scales[s]));
+							std::cerr << "." << std::flush;
+						}
+	}
+	std::cerr << "\n";
+
+	// separate fronts - sparse and dense flow are not interchangeable
+	std::vector<Result> front = paretoFront(lk);
+	std::vector<Result> fb_front = paretoFront(fb);
+	front.insert(front.end(), fb_front.begin(), fb_front.end());
+
+	for (size_t i = 0; i < front.size(); ++i)
+		std::cerr << front[i].component << ": EPE " << front[i].epe << " px, " << front[i].ms << " ms\n";
+
+	if (out_file.empty()) {
+		writeXml(std::cout, front, size);
+	} else {
+		std::ofstream os(out_file.c_str());
+		writeXml(os, front, size);
+	}
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*!
+ * \file
+ * \brief Worker thread with depth-one mailbox for offloading heavy processing
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef ASYNCPROCESSOR_HPP_
+#define ASYNCPROCESSOR_HPP_
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace Types {
+
+/*!
+ * \class AsyncProcessor
+ * \brief Runs job on dedicated thread, always on the newest input.
+ *
+ * Mailbox holds at most one pending input - pushing new one replaces (drops)
+ * the one that wasn't picked up by worker yet. Only the latest finished result
+ * is kept, so that caller can publish it without waiting for computation.
+ */
+template <typename In, typename Out>
+class AsyncProcessor {
+public:
+	typedef boost::function<Out (const In &)> Job;
+
+	AsyncProcessor() : running(false), has_input(false), has_result(false), dropped(0), age(0) {
+	}
+
+	~AsyncProcessor() {
+		stop();
+	}
+
+	/*!
+	 * Starts worker thread executing given job.
+	 */
+	void start(const Job & j) {
+		stop();
+
+		job = j;
+		running = true;
+		has_input = false;
+		has_result = false;
+		dropped = 0;
+		age = 0;
+		worker = boost::thread(boost::bind(&AsyncProcessor::run, this));
+	}
+
+	/*!
+	 * Stops worker thread, waiting for current job to finish.
+	 */
+	void stop() {
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			if (!running)
+				return;
+			running = false;
+		}
+		cond.notify_all();
+		worker.join();
+	}
+
+	bool isRunning() {
+		boost::mutex::scoped_lock lock(mutex);
+		return running;
+	}
+
+	/*!
+	 * Puts new input into mailbox, dropping previous one if still pending.
+	 */
+	void push(const In & in) {
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			if (has_input)
+				++dropped;
+			input = in;
+			input_time = boost::posix_time::microsec_clock::universal_time();
+			has_input = true;
+		}
+		cond.notify_one();
+	}
+
+	/*!
+	 * Takes latest finished result, if there is one not taken yet.
+	 */
+	bool pop(Out & out) {
+		boost::mutex::scoped_lock lock(mutex);
+		if (!has_result)
+			return false;
+		out = result;
+		result = Out();
+		has_result = false;
+		age = 1e-6 * (boost::posix_time::microsec_clock::universal_time() - result_time).total_microseconds();
+		return true;
+	}
+
+	/*!
+	 * Number of inputs dropped without processing since start.
+	 */
+	int droppedCount() {
+		boost::mutex::scoped_lock lock(mutex);
+		return dropped;
+	}
+
+	/*!
+	 * Age (in seconds) of the last popped result, measured from the moment its input was pushed.
+	 */
+	double resultAge() {
+		boost::mutex::scoped_lock lock(mutex);
+		return age;
+	}
+
+private:
+	void run() {
+		for (;;) {
+			In in;
+			boost::posix_time::ptime t;
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				while (running && !has_input)
+					cond.wait(lock);
+				if (!running)
+					return;
+				in = input;
+				t = input_time;
+				input = In();
+				has_input = false;
+			}
+
+			Out out = job(in);
+
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				result = out;
+				result_time = t;
+				has_result = true;
+			}
+		}
+	}
+
+	Job job;
+	boost::thread worker;
+	boost::mutex mutex;
+	boost::condition_variable cond;
+
+	bool running;
+	bool has_input;
+	bool has_result;
+
+	In input;
+	boost::posix_time::ptime input_time;
+	Out result;
+	boost::posix_time::ptime result_time;
+
+	int dropped;
+	double age;
+};
+
+} //: namespace Types
+
+#endif /* ASYNCPROCESSOR_HPP_ */
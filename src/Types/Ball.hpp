@@ -0,0 +1,42 @@
+/*!
+ * \file
+ * \brief Single ball detection
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef BALL_HPP_
+#define BALL_HPP_
+
+#include <stdint.h>
+
+namespace Types {
+
+/*!
+ * \struct Ball
+ * \brief Circle found in single frame (detection or measurement).
+ *
+ * Plain, fixed-layout type - it's copied between components without any
+ * allocation. Replaces [x, y, r] vectors used in older streams.
+ */
+struct Ball {
+	/// Time of the frame the ball was found in (seconds, cv::getTickCount() / cv::getTickFrequency())
+	double timestamp;
+	/// Identifier assigned by the producer (frame number, detection index, track id, ...)
+	uint32_t id;
+	/// Center and radius in pixels
+	float x, y, r;
+
+	static Ball make(float x, float y, float r, double timestamp = 0, uint32_t id = 0) {
+		Ball b;
+		b.timestamp = timestamp;
+		b.id = id;
+		b.x = x;
+		b.y = y;
+		b.r = r;
+		return b;
+	}
+};
+
+} //: namespace Types
+
+#endif /* BALL_HPP_ */
@@ -0,0 +1,251 @@
+/*!
+ * \file
+ * \brief Single-pass connected component labelling with blob moments
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef BLOBLABELER_HPP_
+#define BLOBLABELER_HPP_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <climits>
+
+#include <opencv2/core/core.hpp>
+
+namespace Types {
+
+/*!
+ * \class Blob
+ * \brief Raw moments and bounding box of a single connected region.
+ */
+class Blob {
+public:
+	Blob() : m00(0), m10(0), m01(0), m20(0), m02(0), m11(0), x0(INT_MAX), y0(INT_MAX), x1(-1), y1(-1) {
+	}
+
+	/*!
+	 * Adds horizontal run of pixels [xs, xe] in row y.
+	 */
+	void addRun(int xs, int xe, int y) {
+		double n = xe - xs + 1;
+		double sx = 0.5 * n * (xs + xe);
+		// sum of squares of consecutive integers xs..xe
+		double sxx = sumSq(xe) - sumSq(xs - 1);
+
+		m00 += n;
+		m10 += sx;
+		m01 += n * y;
+		m20 += sxx;
+		m02 += n * y * y;
+		m11 += sx * y;
+
+		x0 = std::min(x0, xs);
+		x1 = std::max(x1, xe);
+		y0 = std::min(y0, y);
+		y1 = std::max(y1, y);
+	}
+
+	void merge(const Blob & o) {
+		m00 += o.m00;
+		m10 += o.m10;
+		m01 += o.m01;
+		m20 += o.m20;
+		m02 += o.m02;
+		m11 += o.m11;
+
+		x0 = std::min(x0, o.x0);
+		x1 = std::max(x1, o.x1);
+		y0 = std::min(y0, o.y0);
+		y1 = std::max(y1, o.y1);
+	}
+
+	float area() const {
+		return m00;
+	}
+
+	cv::Point2f centroid() const {
+		return cv::Point2f(m10 / m00, m01 / m00);
+	}
+
+	/*!
+	 * Radius of a disc with the same second moments as the blob.
+	 */
+	float radius() const {
+		double vx, vy, cxy;
+		central(vx, vy, cxy);
+		return std::sqrt(2 * (vx + vy));
+	}
+
+	/*!
+	 * Circularity in range [0, 1] - product of isotropy (ratio of principal
+	 * axes variances) and fill ratio of the equivalent disc.
+	 */
+	float circularity() const {
+		double vx, vy, cxy;
+		central(vx, vy, cxy);
+
+		double tr = vx + vy;
+		double d = std::sqrt(0.25 * (vx - vy) * (vx - vy) + cxy * cxy);
+		double l1 = 0.5 * tr + d, l2 = 0.5 * tr - d;
+		if (l1 <= 0)
+			return 1;
+
+		double fill = m00 / (CV_PI * 2 * tr);
+		return (l2 / l1) * std::min(fill, 1.0);
+	}
+
+	cv::Rect boundingBox() const {
+		return cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+	}
+
+	double m00, m10, m01, m20, m02, m11;
+	int x0, y0, x1, y1;
+
+private:
+	static double sumSq(double k) {
+		return k * (k + 1) * (2 * k + 1) / 6;
+	}
+
+	void central(double & vx, double & vy, double & cxy) const {
+		double cx = m10 / m00, cy = m01 / m00;
+		// 1/12 accounts for pixel extent, so that single pixel has nonzero size
+		vx = m20 / m00 - cx * cx + 1.0 / 12;
+		vy = m02 / m00 - cy * cy + 1.0 / 12;
+		cxy = m11 / m00 - cx * cy;
+	}
+};
+
+/*!
+ * \class BlobLabeler
+ * \brief Streaming connected component labelling.
+ *
+ * Image is fed row by row, each row is split into runs of foreground pixels,
+ * which are joined with overlapping runs from previous row using union-find.
+ * Moments are accumulated on the fly, so no label image is ever created and
+ * only two rows of runs are kept in memory.
+ */
+class BlobLabeler {
+public:
+	BlobLabeler(bool eight_connected = true) : eight(eight_connected), last_y(-2) {
+	}
+
+	/*!
+	 * Prepares labeler for the next image, keeping allocated memory.
+	 */
+	void reset() {
+		prev.clear();
+		cur.clear();
+		parent.clear();
+		stats.clear();
+		last_y = -2;
+	}
+
+	/*!
+	 * Feeds single row of image. Pixels with value >= thr are foreground.
+	 * \param row pointer to first pixel of processed row fragment
+	 * \param width number of pixels in fragment
+	 * \param y row index in image coordinates
+	 * \param x_offset column of first pixel of fragment in image coordinates
+	 */
+	void pushRow(const uchar * row, int width, int y, uchar thr = 1, int x_offset = 0) {
+		// rows have to be consecutive to be connected
+		if (y != last_y + 1)
+			prev.clear();
+		last_y = y;
+
+		cur.clear();
+		int x = 0;
+		while (x < width) {
+			while (x < width && row[x] < thr)
+				++x;
+			if (x >= width)
+				break;
+			int xs = x;
+			while (x < width && row[x] >= thr)
+				++x;
+			Run r = { xs + x_offset, x - 1 + x_offset, -1 };
+			cur.push_back(r);
+		}
+
+		int d = eight ? 1 : 0;
+		size_t j = 0;
+		for (size_t i = 0; i < cur.size(); ++i) {
+			Run & r = cur[i];
+
+			while (j < prev.size() && prev[j].x1 < r.x0 - d)
+				++j;
+
+			// prev[j] may overlap with next run too, so j is not advanced here
+			for (size_t k = j; k < prev.size() && prev[k].x0 <= r.x1 + d; ++k) {
+				if (r.label < 0)
+					r.label = find(prev[k].label);
+				else
+					r.label = unite(r.label, prev[k].label);
+			}
+
+			if (r.label < 0) {
+				r.label = parent.size();
+				parent.push_back(r.label);
+				stats.push_back(Blob());
+			}
+
+			stats[r.label].addRun(r.x0, r.x1, y);
+		}
+
+		prev.swap(cur);
+	}
+
+	/*!
+	 * Returns all blobs found so far.
+	 */
+	void blobs(std::vector<Blob> & out) {
+		out.clear();
+		for (size_t i = 0; i < parent.size(); ++i)
+			if (parent[i] == (int) i)
+				out.push_back(stats[i]);
+	}
+
+private:
+	struct Run {
+		int x0, x1;
+		int label;
+	};
+
+	int find(int l) {
+		int root = l;
+		while (parent[root] != root)
+			root = parent[root];
+		// path compression
+		while (parent[l] != root) {
+			int next = parent[l];
+			parent[l] = root;
+			l = next;
+		}
+		return root;
+	}
+
+	int unite(int a, int b) {
+		a = find(a);
+		b = find(b);
+		if (a == b)
+			return a;
+		if (b < a)
+			std::swap(a, b);
+		stats[a].merge(stats[b]);
+		parent[b] = a;
+		return a;
+	}
+
+	bool eight;
+	int last_y;
+
+	std::vector<Run> prev, cur;
+	std::vector<int> parent;
+	std::vector<Blob> stats;
+};
+
+} //: namespace Types
+
+#endif /* BLOBLABELER_HPP_ */
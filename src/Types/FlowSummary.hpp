@@ -0,0 +1,36 @@
+/*!
+ * \file
+ * \brief Aggregated motion of a frame
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef FLOWSUMMARY_HPP_
+#define FLOWSUMMARY_HPP_
+
+#include <stdint.h>
+
+namespace Types {
+
+/*!
+ * \struct FlowSummary
+ * \brief Statistics of optical flow between two frames.
+ *
+ * Lets consumers that only need global motion (camera shake, activity level)
+ * skip per-point or per-pixel data.
+ */
+struct FlowSummary {
+	/// Time of the later frame
+	double timestamp;
+	/// Frame sequence number
+	uint32_t id;
+	/// Number of points (or pixels) the statistics are computed from
+	uint32_t count;
+	/// Mean velocity in pixels per second
+	float mean_vx, mean_vy;
+	/// Mean and maximal speed in pixels per second
+	float mean_speed, max_speed;
+};
+
+} //: namespace Types
+
+#endif /* FLOWSUMMARY_HPP_ */
@@ -0,0 +1,39 @@
+/*!
+ * \file
+ * \brief Parallel loop body calling a function for each index
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef FOREACH_HPP_
+#define FOREACH_HPP_
+
+#include <boost/function.hpp>
+
+#include <opencv2/core/core.hpp>
+
+namespace Types {
+
+/*!
+ * \class ForEach
+ * \brief Adapts function of index to cv::parallel_for_.
+ *
+ * Used for batches of independent items (camera streams), where each index
+ * is a separate, coarse task.
+ */
+class ForEach : public cv::ParallelLoopBody {
+public:
+	ForEach(const boost::function<void (int)> & f_) : f(f_) {
+	}
+
+	void operator()(const cv::Range & range) const {
+		for (int i = range.start; i < range.end; ++i)
+			f(i);
+	}
+
+private:
+	boost::function<void (int)> f;
+};
+
+} //: namespace Types
+
+#endif /* FOREACH_HPP_ */
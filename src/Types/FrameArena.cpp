@@ -0,0 +1,137 @@
+/*!
+ * \file
+ * \brief Size-bucketed recycling allocator for frame buffers
+ * \author Maciej Stefańczyk
+ */
+
+#include "FrameArena.hpp"
+
+namespace Types {
+
+namespace {
+
+/// Buffers are rounded up to whole pages, so that slightly different sizes share bucket
+const std::size_t granularity = 4096;
+
+/// Default amount of memory kept in free buffers
+const std::size_t default_capacity = 256 << 20;
+
+} //: namespace
+
+FrameArena & FrameArena::instance() {
+	// intentionally leaked - Mats held in static objects may be released after exit()
+	static FrameArena * arena = new FrameArena;
+	return *arena;
+}
+
+void FrameArena::acquire(cv::Mat & m, cv::Size size, int type) {
+	type = CV_MAT_TYPE(type);
+	// buffer not shared with anyone (also not a view of other Mat) can be reused in place
+	if (m.u && m.u->refcount == 1 && m.dims == 2 && m.size() == size && m.type() == type &&
+			m.isContinuous() && m.data == m.u->data)
+		return;
+
+	m.release();
+	m.allocator = &instance();
+	m.create(size, type);
+}
+
+FrameArena::FrameArena() : cached(0), capacity(default_capacity) {
+}
+
+void FrameArena::setCapacity(std::size_t bytes) {
+	boost::mutex::scoped_lock lock(mutex);
+	capacity = bytes;
+
+	// drop largest buffers first, they are the least likely to be needed again
+	while (cached > capacity && !free_buffers.empty()) {
+		std::map<std::size_t, std::vector<uchar *> >::iterator it = --free_buffers.end();
+		cv::fastFree(it->second.back());
+		it->second.pop_back();
+		cached -= it->first;
+		if (it->second.empty())
+			free_buffers.erase(it);
+	}
+}
+
+std::size_t FrameArena::cachedBytes() const {
+	boost::mutex::scoped_lock lock(mutex);
+	return cached;
+}
+
+std::size_t FrameArena::bucket(std::size_t bytes) {
+	return (bytes + granularity - 1) / granularity * granularity;
+}
+
+uchar * FrameArena::take(std::size_t bytes) const {
+	std::size_t b = bucket(bytes);
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		std::map<std::size_t, std::vector<uchar *> >::iterator it = free_buffers.find(b);
+		if (it != free_buffers.end()) {
+			uchar * data = it->second.back();
+			it->second.pop_back();
+			cached -= b;
+			if (it->second.empty())
+				free_buffers.erase(it);
+			return data;
+		}
+	}
+	return (uchar *) cv::fastMalloc(b);
+}
+
+void FrameArena::give(uchar * data, std::size_t bytes) const {
+	std::size_t b = bucket(bytes);
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		if (cached + b <= capacity) {
+			free_buffers[b].push_back(data);
+			cached += b;
+			return;
+		}
+	}
+	cv::fastFree(data);
+}
+
+cv::UMatData * FrameArena::allocate(int dims, const int * sizes, int type, void * data0, size_t * step,
+		AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+	// same layout as in OpenCV default allocator
+	size_t total = CV_ELEM_SIZE(type);
+	for (int i = dims - 1; i >= 0; i--) {
+		if (step) {
+			if (data0 && step[i] != CV_AUTOSTEP) {
+				CV_Assert(total <= step[i]);
+				total = step[i];
+			} else {
+				step[i] = total;
+			}
+		}
+		total *= sizes[i];
+	}
+
+	cv::UMatData * u = new cv::UMatData(this);
+	u->data = u->origdata = data0 ? (uchar *) data0 : take(total);
+	u->size = total;
+	if (data0)
+		u->flags |= cv::UMatData::USER_ALLOCATED;
+	return u;
+}
+
+bool FrameArena::allocate(cv::UMatData * u, AccessFlag /*accessflags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+	return u != NULL;
+}
+
+void FrameArena::deallocate(cv::UMatData * u) const {
+	if (!u)
+		return;
+
+	CV_Assert(u->urefcount == 0);
+	CV_Assert(u->refcount == 0);
+	if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+		give(u->origdata, u->size);
+		u->origdata = 0;
+	}
+	delete u;
+}
+
+} //: namespace Types
@@ -0,0 +1,86 @@
+/*!
+ * \file
+ * \brief Size-bucketed recycling allocator for frame buffers
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef FRAMEARENA_HPP_
+#define FRAMEARENA_HPP_
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/version.hpp>
+
+namespace Types {
+
+/*!
+ * \class FrameArena
+ * \brief Process-wide pool of frame buffers, shared by all components.
+ *
+ * Mats allocated from the arena return their memory to it when the last
+ * reference is released (reference counting is done by cv::Mat as usual),
+ * and the memory is handed out again for the next buffer of the same size
+ * bucket. In steady state, when frame size doesn't change, no heap allocation
+ * is done at all.
+ *
+ * Buffers are acquired with acquire(), which keeps the buffer if nobody else
+ * holds it (so private buffers and double buffers are reused in place) and
+ * takes another one from the arena if it was passed downstream.
+ */
+class FrameArena : public cv::MatAllocator {
+public:
+#if CV_VERSION_MAJOR >= 4
+	typedef cv::AccessFlag AccessFlag;
+#else
+	typedef int AccessFlag;
+#endif
+
+	/*!
+	 * Arena instance. It's never destroyed, so Mats may outlive everything else.
+	 */
+	static FrameArena & instance();
+
+	/*!
+	 * Makes m a buffer of given size and type that isn't shared with anyone.
+	 * Contents are undefined if the buffer had to be replaced.
+	 */
+	static void acquire(cv::Mat & m, cv::Size size, int type);
+
+	/*!
+	 * Sets maximal number of bytes kept in free buffers, surplus is returned to the system.
+	 */
+	void setCapacity(std::size_t bytes);
+
+	/// Number of bytes kept in free buffers
+	std::size_t cachedBytes() const;
+
+	// cv::MatAllocator interface
+	cv::UMatData * allocate(int dims, const int * sizes, int type, void * data, size_t * step,
+			AccessFlag flags, cv::UMatUsageFlags usageFlags) const;
+	bool allocate(cv::UMatData * data, AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const;
+	void deallocate(cv::UMatData * data) const;
+
+private:
+	FrameArena();
+
+	/// Size of the bucket given number of bytes falls into
+	static std::size_t bucket(std::size_t bytes);
+
+	uchar * take(std::size_t bytes) const;
+	void give(uchar * data, std::size_t bytes) const;
+
+	mutable boost::mutex mutex;
+	/// Free buffers by bucket size
+	mutable std::map<std::size_t, std::vector<uchar *> > free_buffers;
+	mutable std::size_t cached;
+	std::size_t capacity;
+};
+
+} //: namespace Types
+
+#endif /* FRAMEARENA_HPP_ */
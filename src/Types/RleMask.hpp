@@ -0,0 +1,164 @@
+/*!
+ * \file
+ * \brief Run-length encoded binary mask with dirty-rectangle delta
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef RLEMASK_HPP_
+#define RLEMASK_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+#include <opencv2/core/core.hpp>
+
+namespace Types {
+
+/*!
+ * \class RleMask
+ * \brief Binary mask stored as horizontal runs of foreground pixels.
+ *
+ * Runs of row y are runs[rows[y]] .. runs[rows[y + 1] - 1], each holding
+ * [begin, end) range of x coordinates. Mostly empty masks take a few bytes per
+ * row, and consumers interested only in foreground can iterate runs directly.
+ */
+class RleMask {
+public:
+	RleMask() : width(0), height(0) {
+	}
+
+	/*!
+	 * Encodes 8-bit mask, every non-zero pixel is foreground.
+	 */
+	void encode(const cv::Mat & mask) {
+		CV_Assert(mask.type() == CV_8UC1);
+		width = mask.cols;
+		height = mask.rows;
+		rows.resize(height + 1);
+		runs.clear();
+
+		for (int y = 0; y < height; ++y) {
+			rows[y] = runs.size();
+			const uchar * row = mask.ptr<uchar>(y);
+			int x = 0;
+			while (x < width) {
+				while (x < width && !row[x])
+					++x;
+				if (x == width)
+					break;
+				int b = x;
+				while (x < width && row[x])
+					++x;
+				runs.push_back(cv::Vec2i(b, x));
+			}
+		}
+		rows[height] = runs.size();
+	}
+
+	/*!
+	 * Decodes whole mask, foreground is set to 255.
+	 */
+	void decode(cv::Mat & mask) const {
+		mask.create(height, width, CV_8UC1);
+		mask.setTo(0);
+		decode(mask, cv::Rect(0, 0, width, height));
+	}
+
+	/*!
+	 * Decodes region of the mask into matching region of given (already allocated) image.
+	 * Background pixels of the region are left untouched.
+	 */
+	void decode(cv::Mat & mask, const cv::Rect & region) const {
+		cv::Rect r = region & cv::Rect(0, 0, width, height);
+		for (int y = r.y; y < r.y + r.height; ++y) {
+			uchar * row = mask.ptr<uchar>(y);
+			for (int i = rows[y]; i < rows[y + 1]; ++i) {
+				int b = std::max(runs[i][0], r.x), e = std::min(runs[i][1], r.x + r.width);
+				if (b < e)
+					std::fill(row + b, row + e, 255);
+			}
+		}
+	}
+
+	/*!
+	 * Number of runs in given row.
+	 */
+	int rowRuns(int y) const {
+		return rows[y + 1] - rows[y];
+	}
+
+	/*!
+	 * Computes rectangles covering all pixels that differ between two masks.
+	 * Changed span of each row is bounded by its first and last differing run,
+	 * consecutive changed rows are merged into single rectangle.
+	 */
+	static void diff(const RleMask & prev, const RleMask & cur, std::vector<cv::Rect> & dirty) {
+		dirty.clear();
+		if (prev.width != cur.width || prev.height != cur.height) {
+			if (cur.width > 0 && cur.height > 0)
+				dirty.push_back(cv::Rect(0, 0, cur.width, cur.height));
+			return;
+		}
+
+		cv::Rect band;
+		for (int y = 0; y < cur.height; ++y) {
+			int x0, x1;
+			if (!rowSpan(prev, cur, y, x0, x1)) {
+				if (band.area() > 0)
+					dirty.push_back(band);
+				band = cv::Rect();
+				continue;
+			}
+			cv::Rect span(x0, y, x1 - x0, 1);
+			band = band.area() > 0 ? (band | span) : span;
+		}
+		if (band.area() > 0)
+			dirty.push_back(band);
+	}
+
+	int width;
+	int height;
+
+	/// Index of the first run of each row, with total count at the end
+	std::vector<int> rows;
+	/// Foreground runs, [begin, end)
+	std::vector<cv::Vec2i> runs;
+
+private:
+	/*!
+	 * Range [x0, x1) of row y containing all changes, false if row is unchanged.
+	 */
+	static bool rowSpan(const RleMask & a, const RleMask & b, int y, int & x0, int & x1) {
+		const cv::Vec2i * ra = a.runs.empty() ? NULL : &a.runs[0] + a.rows[y];
+		const cv::Vec2i * rb = b.runs.empty() ? NULL : &b.runs[0] + b.rows[y];
+		int na = a.rowRuns(y), nb = b.rowRuns(y);
+
+		int f = 0;
+		while (f < na && f < nb && ra[f] == rb[f])
+			++f;
+		if (f == na && f == nb)
+			return false;
+
+		int l = 0;
+		while (l < na - f && l < nb - f && ra[na - 1 - l] == rb[nb - 1 - l])
+			++l;
+
+		// first and last differing runs of both rows
+		x0 = INT_MAX;
+		x1 = INT_MIN;
+		if (na - l > f) {
+			x0 = std::min(x0, ra[f][0]);
+			x1 = std::max(x1, ra[na - 1 - l][1]);
+		}
+		if (nb - l > f) {
+			x0 = std::min(x0, rb[f][0]);
+			x1 = std::max(x1, rb[nb - 1 - l][1]);
+		}
+		return true;
+	}
+};
+
+} //: namespace Types
+
+#endif /* RLEMASK_HPP_ */
@@ -0,0 +1,217 @@
+/*!
+ * \file
+ * \brief Compact binary encoding of tracking messages
+ * \author Maciej Stefańczyk
+ */
+
+#include "Serialization.hpp"
+
+#include <cstring>
+
+namespace Types {
+
+namespace {
+
+/// Encoded size of single track (timestamp, id, lost, x, y, r, vx, vy)
+const std::size_t track_size = 8 + 4 + 4 + 5 * 4;
+
+/*!
+ * Sequential writer of fields. Supported platforms are little endian, so
+ * fields are copied as they are.
+ */
+class Writer {
+public:
+	Writer(char * buf) : m_buf(buf), m_pos(0) {
+	}
+
+	template <typename T>
+	void put(const T & v) {
+		std::memcpy(m_buf + m_pos, &v, sizeof(T));
+		m_pos += sizeof(T);
+	}
+
+	std::size_t pos() const {
+		return m_pos;
+	}
+
+private:
+	char * m_buf;
+	std::size_t m_pos;
+};
+
+/*!
+ * Sequential reader of fields, with bounds checking.
+ */
+class Reader {
+public:
+	Reader(const char * buf, std::size_t size) : m_buf(buf), m_size(size), m_pos(0), m_ok(true) {
+	}
+
+	template <typename T>
+	void get(T & v) {
+		if (!m_ok || m_pos + sizeof(T) > m_size) {
+			m_ok = false;
+			return;
+		}
+		std::memcpy(&v, m_buf + m_pos, sizeof(T));
+		m_pos += sizeof(T);
+	}
+
+	/*!
+	 * Reads and checks message tag.
+	 */
+	void expect(uint8_t tag) {
+		uint8_t t = 0;
+		get(t);
+		m_ok = m_ok && t == tag;
+	}
+
+	/// Bytes consumed, 0 on error
+	std::size_t result() const {
+		return m_ok ? m_pos : 0;
+	}
+
+	bool ok() const {
+		return m_ok;
+	}
+
+private:
+	const char * m_buf;
+	std::size_t m_size;
+	std::size_t m_pos;
+	bool m_ok;
+};
+
+void putTrack(Writer & w, const Track & t) {
+	w.put(t.timestamp);
+	w.put(t.id);
+	w.put(t.lost);
+	w.put(t.x);
+	w.put(t.y);
+	w.put(t.r);
+	w.put(t.vx);
+	w.put(t.vy);
+}
+
+void getTrack(Reader & r, Track & t) {
+	r.get(t.timestamp);
+	r.get(t.id);
+	r.get(t.lost);
+	r.get(t.x);
+	r.get(t.y);
+	r.get(t.r);
+	r.get(t.vx);
+	r.get(t.vy);
+}
+
+} //: namespace
+
+int messageTag(const char * buf, std::size_t size) {
+	return size > 0 ? (uint8_t) buf[0] : 0;
+}
+
+std::size_t serializedSize(const Ball &) {
+	return 1 + 8 + 4 + 3 * 4;
+}
+
+std::size_t serializedSize(const Track &) {
+	return 1 + track_size;
+}
+
+std::size_t serializedSize(const TrackSet & m) {
+	return 1 + 8 + 4 + 4 + m.count * track_size;
+}
+
+std::size_t serializedSize(const FlowSummary &) {
+	return 1 + 8 + 4 + 4 + 4 * 4;
+}
+
+std::size_t serialize(const Ball & m, char * buf) {
+	Writer w(buf);
+	w.put((uint8_t) TagBall);
+	w.put(m.timestamp);
+	w.put(m.id);
+	w.put(m.x);
+	w.put(m.y);
+	w.put(m.r);
+	return w.pos();
+}
+
+std::size_t serialize(const Track & m, char * buf) {
+	Writer w(buf);
+	w.put((uint8_t) TagTrack);
+	putTrack(w, m);
+	return w.pos();
+}
+
+std::size_t serialize(const TrackSet & m, char * buf) {
+	Writer w(buf);
+	w.put((uint8_t) TagTrackSet);
+	w.put(m.timestamp);
+	w.put(m.id);
+	w.put(m.count);
+	for (uint32_t i = 0; i < m.count; ++i)
+		putTrack(w, m.tracks[i]);
+	return w.pos();
+}
+
+std::size_t serialize(const FlowSummary & m, char * buf) {
+	Writer w(buf);
+	w.put((uint8_t) TagFlowSummary);
+	w.put(m.timestamp);
+	w.put(m.id);
+	w.put(m.count);
+	w.put(m.mean_vx);
+	w.put(m.mean_vy);
+	w.put(m.mean_speed);
+	w.put(m.max_speed);
+	return w.pos();
+}
+
+std::size_t deserialize(const char * buf, std::size_t size, Ball & m) {
+	Reader r(buf, size);
+	r.expect(TagBall);
+	r.get(m.timestamp);
+	r.get(m.id);
+	r.get(m.x);
+	r.get(m.y);
+	r.get(m.r);
+	return r.result();
+}
+
+std::size_t deserialize(const char * buf, std::size_t size, Track & m) {
+	Reader r(buf, size);
+	r.expect(TagTrack);
+	getTrack(r, m);
+	return r.result();
+}
+
+std::size_t deserialize(const char * buf, std::size_t size, TrackSet & m) {
+	Reader r(buf, size);
+	r.expect(TagTrackSet);
+	r.get(m.timestamp);
+	r.get(m.id);
+	r.get(m.count);
+	if (!r.ok() || m.count > TrackSet::Capacity) {
+		m.count = 0;
+		return 0;
+	}
+	for (uint32_t i = 0; i < m.count; ++i)
+		getTrack(r, m.tracks[i]);
+	return r.result();
+}
+
+std::size_t deserialize(const char * buf, std::size_t size, FlowSummary & m) {
+	Reader r(buf, size);
+	r.expect(TagFlowSummary);
+	r.get(m.timestamp);
+	r.get(m.id);
+	r.get(m.count);
+	r.get(m.mean_vx);
+	r.get(m.mean_vy);
+	r.get(m.mean_speed);
+	r.get(m.max_speed);
+	return r.result();
+}
+
+} //: namespace Types
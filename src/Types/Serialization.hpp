@@ -0,0 +1,63 @@
+/*!
+ * \file
+ * \brief Compact binary encoding of tracking messages
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef SERIALIZATION_HPP_
+#define SERIALIZATION_HPP_
+
+#include <cstddef>
+
+#include "Ball.hpp"
+#include "Track.hpp"
+#include "FlowSummary.hpp"
+
+namespace Types {
+
+/*!
+ * Tag written as the first byte of every message, so that records of
+ * different types can be mixed in one stream or file.
+ */
+enum MessageTag {
+	TagBall = 1,
+	TagTrack = 2,
+	TagTrackSet = 3,
+	TagFlowSummary = 4
+};
+
+/*!
+ * Tag of the message stored in buffer, 0 if buffer is empty.
+ */
+int messageTag(const char * buf, std::size_t size);
+
+/*!
+ * Number of bytes needed to encode message.
+ */
+std::size_t serializedSize(const Ball & m);
+std::size_t serializedSize(const Track & m);
+std::size_t serializedSize(const TrackSet & m);
+std::size_t serializedSize(const FlowSummary & m);
+
+/*!
+ * Encodes message (fields packed without padding, little endian) into buffer
+ * of at least serializedSize(m) bytes. Only valid entries of TrackSet are written.
+ * \returns number of bytes written
+ */
+std::size_t serialize(const Ball & m, char * buf);
+std::size_t serialize(const Track & m, char * buf);
+std::size_t serialize(const TrackSet & m, char * buf);
+std::size_t serialize(const FlowSummary & m, char * buf);
+
+/*!
+ * Decodes message from buffer.
+ * \returns number of bytes consumed, 0 if buffer is too short or holds different message
+ */
+std::size_t deserialize(const char * buf, std::size_t size, Ball & m);
+std::size_t deserialize(const char * buf, std::size_t size, Track & m);
+std::size_t deserialize(const char * buf, std::size_t size, TrackSet & m);
+std::size_t deserialize(const char * buf, std::size_t size, FlowSummary & m);
+
+} //: namespace Types
+
+#endif /* SERIALIZATION_HPP_ */
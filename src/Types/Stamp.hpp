@@ -0,0 +1,37 @@
+/*!
+ * \file
+ * \brief Capture time and sequence number travelling with frame data
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef STAMP_HPP_
+#define STAMP_HPP_
+
+#include <stdint.h>
+
+namespace Types {
+
+/*!
+ * \struct Stamp
+ * \brief Identifies the camera frame data was derived from.
+ *
+ * Components pass it on an out_stamp stream next to their results, so that
+ * age of any derived measurement can be computed at the end of the pipeline.
+ */
+struct Stamp {
+	/// Capture time of the frame (seconds, cv::getTickCount() / cv::getTickFrequency())
+	double capture;
+	/// Frame sequence number
+	uint32_t seq;
+
+	static Stamp make(double capture, uint32_t seq) {
+		Stamp s;
+		s.capture = capture;
+		s.seq = seq;
+		return s;
+	}
+};
+
+} //: namespace Types
+
+#endif /* STAMP_HPP_ */
@@ -0,0 +1,389 @@
+/*!
+ * \file
+ * \brief Process-wide work-stealing task pool shared by all components
+ * \author Maciej Stefańczyk
+ */
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <opencv2/core/version.hpp>
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)))
+#define HAVE_PARALLEL_BACKEND
+#include <opencv2/core/parallel/parallel_backend.hpp>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Types {
+
+namespace {
+
+/*!
+ * Pool related state of a thread.
+ */
+struct ThreadState {
+	/// Worker index, -1 for threads outside of the pool
+	int worker;
+	/// Priority and affinity inherited by submitted tasks
+	int priority;
+	uint64_t affinity;
+
+	ThreadState() : worker(-1), priority(ThreadPool::Normal), affinity(ThreadPool::AnyCore) {
+	}
+};
+
+boost::thread_specific_ptr<ThreadState> thread_state;
+
+ThreadState & state() {
+	if (!thread_state.get())
+		thread_state.reset(new ThreadState);
+	return *thread_state;
+}
+
+/*!
+ * Single stripe of parallel loop.
+ */
+struct Stripe {
+	const cv::ParallelLoopBody * body;
+	cv::Range range;
+
+	void operator()() const {
+		(*body)(range);
+	}
+};
+
+#ifndef HAVE_PARALLEL_BACKEND
+boost::mutex serial_mutex;
+/// Number of pool loops running and OpenCV thread count from before the first one
+int serial_loops = 0;
+int serial_saved = -1;
+
+/*!
+ * Keeps OpenCV loops serial while any pool loop runs. OpenCV threading is
+ * process-wide, so it's changed only for the time of pool loops - components
+ * not using the pool keep OpenCV threads otherwise.
+ */
+class SerialOpenCV {
+public:
+	SerialOpenCV() {
+		boost::mutex::scoped_lock lock(serial_mutex);
+		if (serial_loops++ == 0) {
+			serial_saved = cv::getNumThreads();
+			cv::setNumThreads(1);
+		}
+	}
+
+	~SerialOpenCV() {
+		boost::mutex::scoped_lock lock(serial_mutex);
+		if (--serial_loops == 0)
+			cv::setNumThreads(serial_saved);
+	}
+};
+#endif
+
+#ifdef HAVE_PARALLEL_BACKEND
+/*!
+ * OpenCV parallel backend executing loops in the pool.
+ */
+class PoolBackend : public cv::parallel::ParallelForAPI {
+public:
+	void parallel_for(int tasks, FN_parallel_for_body_cb_t body_callback, void * callback_data) {
+		if (tasks <= 0)
+			return;
+		// first stripe runs on calling thread, the rest is queued
+		TaskGroup group;
+		for (int i = 1; i < tasks; ++i)
+			group.run(boost::bind(body_callback, i, i + 1, callback_data));
+		body_callback(0, 1, callback_data);
+		group.wait();
+	}
+
+	int getThreadNum() const {
+		return ThreadPool::instance().workerIndex() + 1;
+	}
+
+	int getNumThreads() const {
+		return ThreadPool::instance().size() + 1;
+	}
+
+	int setNumThreads(int) {
+		// pool size is fixed, OpenCV can't change it
+		return getNumThreads();
+	}
+
+	const char * getName() const {
+		return "tracking";
+	}
+};
+#endif
+
+} //: namespace
+
+ThreadPool::Context::Context(int priority, uint64_t affinity) {
+	ThreadState & s = state();
+	m_priority = s.priority;
+	m_affinity = s.affinity;
+	s.priority = std::max<int>(Low, std::min<int>(High, priority));
+	s.affinity = affinity;
+}
+
+ThreadPool::Context::~Context() {
+	ThreadState & s = state();
+	s.priority = m_priority;
+	s.affinity = m_affinity;
+}
+
+ThreadPool & ThreadPool::instance() {
+	static ThreadPool pool(boost::thread::hardware_concurrency());
+	return pool;
+}
+
+uint64_t ThreadPool::parseAffinity(const std::string & cores) {
+	uint64_t mask = 0;
+	std::stringstream ss(cores);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		if (item.empty())
+			continue;
+		int first = 0, last = 0;
+		std::string::size_type dash = item.find('-');
+		first = std::atoi(item.substr(0, dash).c_str());
+		last = dash == std::string::npos ? first : std::atoi(item.substr(dash + 1).c_str());
+		for (int c = std::max(first, 0); c <= last && c < 64; ++c)
+			mask |= (uint64_t) 1 << c;
+	}
+	return mask ? mask : AnyCore;
+}
+
+ThreadPool::ThreadPool(int threads) : running(true), pending(0), next_worker(0) {
+	threads = std::max(1, std::min(threads, 64));
+	for (int i = 0; i < threads; ++i)
+		workers.push_back(new Worker);
+	for (int i = 0; i < threads; ++i) {
+		workers[i]->thread = boost::thread(boost::bind(&ThreadPool::run, this, i));
+#ifdef __linux__
+		// worker i always runs on core i, so that affinity masks select cores
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(i % std::max(1u, boost::thread::hardware_concurrency()), &cpus);
+		pthread_setaffinity_np(workers[i]->thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+	}
+
+	installOpenCVBackend();
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		boost::mutex::scoped_lock lock(sleep_mutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); ++i) {
+		workers[i]->thread.join();
+		delete workers[i];
+	}
+}
+
+void ThreadPool::installOpenCVBackend() {
+#ifdef HAVE_PARALLEL_BACKEND
+	cv::parallel::setParallelForBackend(std::make_shared<PoolBackend>(), false);
+#endif
+}
+
+int ThreadPool::size() const {
+	return workers.size();
+}
+
+int ThreadPool::workerIndex() const {
+	return state().worker;
+}
+
+void ThreadPool::submit(const Task & task, TaskGroup & group) {
+	const ThreadState & s = state();
+	uint64_t all = workers.size() >= 64 ? AnyCore : (((uint64_t) 1 << workers.size()) - 1);
+
+	Item item;
+	item.task = task;
+	item.group = &group;
+	item.priority = s.priority;
+	item.affinity = (s.affinity & all) ? (s.affinity & all) : all;
+
+	// own queue keeps data hot in cache, otherwise next allowed worker
+	int target = -1;
+	if (s.worker >= 0 && (item.affinity >> s.worker) & 1) {
+		target = s.worker;
+	} else {
+		unsigned start = next_worker++;
+		for (size_t i = 0; i < workers.size() && target < 0; ++i) {
+			int w = (start + i) % workers.size();
+			if ((item.affinity >> w) & 1)
+				target = w;
+		}
+	}
+
+	++group.count;
+	{
+		boost::mutex::scoped_lock lock(workers[target]->mutex);
+		workers[target]->queues[item.priority].push_back(item);
+	}
+	{
+		boost::mutex::scoped_lock lock(sleep_mutex);
+		++pending;
+	}
+
+	// with restricted affinity woken worker may not be allowed to run the task
+	if (item.affinity == all)
+		wake.notify_one();
+	else
+		wake.notify_all();
+}
+
+void ThreadPool::parallelFor(const cv::Range & range, const cv::ParallelLoopBody & body, double nstripes) {
+	int len = range.end - range.start;
+	if (len <= 0)
+		return;
+
+	int stripes = nstripes <= 0 ? std::min<int>(len, 4 * (size() + 1)) : std::min<int>(len, std::max(1, cvRound(nstripes)));
+	if (stripes == 1) {
+		body(range);
+		return;
+	}
+
+#ifndef HAVE_PARALLEL_BACKEND
+	// no way to redirect OpenCV loops - keep them serial instead of oversubscribing cores
+	SerialOpenCV serial;
+#endif
+
+	TaskGroup group;
+	for (int i = 0; i < stripes; ++i) {
+		Stripe s;
+		s.body = &body;
+		s.range = cv::Range(range.start + (int64_t) len * i / stripes, range.start + (int64_t) len * (i + 1) / stripes);
+		group.run(s);
+	}
+	group.wait();
+}
+
+void ThreadPool::run(int index) {
+	state().worker = index;
+
+	while (running) {
+		if (runOne(index, NULL))
+			continue;
+
+		boost::mutex::scoped_lock lock(sleep_mutex);
+		if (!running)
+			break;
+		if (pending == 0)
+			wake.wait(lock);
+		else
+			// queued tasks are meant for other cores
+			wake.timed_wait(lock, boost::posix_time::milliseconds(1));
+	}
+}
+
+bool ThreadPool::take(Worker & w, int p, bool back, int self, TaskGroup * group, Item & item) {
+	boost::mutex::scoped_lock lock(w.mutex);
+	std::deque<Item> & q = w.queues[p];
+	for (size_t i = 0; i < q.size(); ++i) {
+		size_t k = back ? q.size() - 1 - i : i;
+		bool ok = group ? q[k].group == group : ((q[k].affinity >> self) & 1);
+		if (!ok)
+			continue;
+		item = q[k];
+		q.erase(q.begin() + k);
+		--pending;
+		return true;
+	}
+	return false;
+}
+
+bool ThreadPool::runOne(int self, TaskGroup * group) {
+	Item item;
+	bool found = false;
+	for (int p = High; p >= Low && !found; --p) {
+		if (self >= 0)
+			found = take(*workers[self], p, true, self, group, item);
+		for (size_t i = 1; i <= workers.size() && !found; ++i) {
+			int w = (self + i) % workers.size();
+			if (w != self)
+				found = take(*workers[w], p, false, self, group, item);
+		}
+	}
+	if (!found)
+		return false;
+
+	// nested tasks inherit priority and affinity of the running one
+	Context context(item.priority, item.affinity);
+	std::string error;
+	try {
+		item.task();
+	} catch (const std::exception & e) {
+		error = e.what();
+		if (error.empty())
+			error = "unknown error";
+	} catch (...) {
+		error = "unknown error";
+	}
+	item.group->finished(error);
+	return true;
+}
+
+TaskGroup::TaskGroup() : count(0) {
+}
+
+TaskGroup::~TaskGroup() {
+	try {
+		wait();
+	} catch (...) {
+	}
+}
+
+void TaskGroup::run(const ThreadPool::Task & task) {
+	ThreadPool::instance().submit(task, *this);
+}
+
+void TaskGroup::wait() {
+	ThreadPool & pool = ThreadPool::instance();
+	int self = pool.workerIndex();
+	while (count > 0) {
+		if (pool.runOne(self, this))
+			continue;
+
+		boost::mutex::scoped_lock lock(mutex);
+		if (count > 0)
+			done.timed_wait(lock, boost::posix_time::milliseconds(1));
+	}
+
+	boost::mutex::scoped_lock lock(mutex);
+	if (!error.empty()) {
+		std::string e;
+		e.swap(error);
+		throw std::runtime_error(e);
+	}
+}
+
+void TaskGroup::finished(const std::string & e) {
+	boost::mutex::scoped_lock lock(mutex);
+	if (!e.empty() && error.empty())
+		error = e;
+	if (--count == 0)
+		done.notify_all();
+}
+
+} //: namespace Types
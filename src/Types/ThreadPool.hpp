@@ -0,0 +1,181 @@
+/*!
+ * \file
+ * \brief Process-wide work-stealing task pool shared by all components
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <opencv2/core/core.hpp>
+
+namespace Types {
+
+class TaskGroup;
+
+/*!
+ * \class ThreadPool
+ * \brief Single pool of worker threads for frame- and tile-level tasks.
+ *
+ * Every worker has its own queues (one per priority). Tasks submitted from a
+ * worker go to its own queue and are taken LIFO, idle workers steal the oldest
+ * tasks of others. Higher priority tasks are always taken first.
+ *
+ * Priority and core affinity are taken from the Context active on the
+ * submitting thread, so component sets them once per handler and all tasks
+ * it creates (also nested ones, and ones created by OpenCV functions) inherit
+ * them. Workers are pinned to cores, affinity mask selects workers that may
+ * run the task.
+ *
+ * Pool is started lazily, by the first component that actually uses it.
+ * From then on OpenCV internal parallelism is redirected to the pool
+ * (OpenCV 4.5.2+). Older versions can't redirect it, there OpenCV loops are
+ * kept serial only while pool loops run, so that they don't compete for
+ * cores, and get their own threads back afterwards.
+ */
+class ThreadPool {
+public:
+	typedef boost::function<void ()> Task;
+
+	enum Priority {
+		Low = 0,
+		Normal = 1,
+		High = 2,
+		Priorities = 3
+	};
+
+	/// Affinity allowing all workers
+	static const uint64_t AnyCore = ~(uint64_t) 0;
+
+	/*!
+	 * \class Context
+	 * \brief Sets priority and affinity of tasks submitted by current thread, restores previous ones on exit.
+	 */
+	class Context {
+	public:
+		Context(int priority, uint64_t affinity);
+		~Context();
+
+	private:
+		int m_priority;
+		uint64_t m_affinity;
+	};
+
+	/*!
+	 * Pool instance, started on first use with one worker per core.
+	 */
+	static ThreadPool & instance();
+
+	/*!
+	 * Parses core list like "0-3,6" into affinity mask, empty string means any core.
+	 */
+	static uint64_t parseAffinity(const std::string & cores);
+
+	/*!
+	 * Queues task, it will be run as a part of given group.
+	 */
+	void submit(const Task & task, TaskGroup & group);
+
+	/*!
+	 * Runs body on range split into (roughly) nstripes tasks and waits for
+	 * all of them - drop-in replacement of cv::parallel_for_. Waiting thread
+	 * executes tasks of the loop as well.
+	 */
+	void parallelFor(const cv::Range & range, const cv::ParallelLoopBody & body, double nstripes = -1);
+
+	/// Number of worker threads
+	int size() const;
+
+	/// Index of worker executing current thread, -1 outside of the pool
+	int workerIndex() const;
+
+	~ThreadPool();
+
+private:
+	friend class TaskGroup;
+
+	struct Item {
+		Task task;
+		TaskGroup * group;
+		int priority;
+		uint64_t affinity;
+	};
+
+	struct Worker {
+		boost::mutex mutex;
+		std::deque<Item> queues[Priorities];
+		boost::thread thread;
+	};
+
+	ThreadPool(int threads);
+
+	void run(int index);
+
+	/*!
+	 * Takes and executes single task. Pool workers (group == NULL) take any
+	 * task they are allowed to run, waiting threads take only tasks of the
+	 * group they wait for.
+	 * \returns false if there was no task to run
+	 */
+	bool runOne(int self, TaskGroup * group);
+
+	bool take(Worker & w, int p, bool back, int self, TaskGroup * group, Item & item);
+
+	void installOpenCVBackend();
+
+	std::vector<Worker *> workers;
+	boost::atomic<bool> running;
+	/// Number of queued (not yet taken) tasks
+	boost::atomic<int> pending;
+	boost::atomic<unsigned> next_worker;
+
+	boost::mutex sleep_mutex;
+	boost::condition_variable wake;
+};
+
+/*!
+ * \class TaskGroup
+ * \brief Set of tasks that can be waited for together.
+ */
+class TaskGroup {
+public:
+	TaskGroup();
+	~TaskGroup();
+
+	/*!
+	 * Queues task in the pool.
+	 */
+	void run(const ThreadPool::Task & task);
+
+	/*!
+	 * Waits for all tasks of the group, executing them meanwhile. Rethrows
+	 * (as std::runtime_error) first exception thrown by any of the tasks.
+	 */
+	void wait();
+
+private:
+	friend class ThreadPool;
+
+	void finished(const std::string & error);
+
+	boost::atomic<int> count;
+	boost::mutex mutex;
+	boost::condition_variable done;
+	std::string error;
+};
+
+} //: namespace Types
+
+#endif /* THREADPOOL_HPP_ */
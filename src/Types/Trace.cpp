@@ -0,0 +1,141 @@
+/*!
+ * \file
+ * \brief Process-wide ring buffer of pipeline stage timings
+ * \author Maciej Stefańczyk
+ */
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Types {
+namespace Trace {
+
+namespace {
+
+boost::mutex names_mutex;
+std::vector<std::string> names;
+
+/// Ring buffer, capacity is a power of two
+std::vector<Event> buffer;
+std::size_t mask = 0;
+
+boost::atomic<bool> recording(false);
+/// Number of events written since enable()
+boost::atomic<std::size_t> head(0);
+/// Writers currently inside record(), buffer isn't reallocated until they leave
+boost::atomic<int> writers(0);
+
+void quiesce() {
+	recording = false;
+	while (writers > 0)
+		boost::this_thread::yield();
+}
+
+} //: namespace
+
+int stage(const std::string & name) {
+	boost::mutex::scoped_lock lock(names_mutex);
+	std::vector<std::string>::iterator it = std::find(names.begin(), names.end(), name);
+	if (it != names.end())
+		return it - names.begin();
+	names.push_back(name);
+	return names.size() - 1;
+}
+
+void enable(std::size_t capacity) {
+	quiesce();
+
+	std::size_t cap = 1;
+	while (cap < capacity)
+		cap <<= 1;
+	buffer.resize(cap);
+	mask = cap - 1;
+	head = 0;
+
+	recording = true;
+}
+
+void disable() {
+	quiesce();
+}
+
+bool enabled() {
+	return recording.load(boost::memory_order_relaxed);
+}
+
+void record(int stage, const Stamp & stamp, double begin, double end) {
+	if (!recording.load(boost::memory_order_relaxed))
+		return;
+
+	++writers;
+	if (recording) {
+		Event & e = buffer[head.fetch_add(1) & mask];
+		e.stage = stage;
+		e.stamp = stamp;
+		e.begin = begin;
+		e.end = end;
+	}
+	--writers;
+}
+
+std::vector<Event> events() {
+	std::vector<Event> res;
+	if (buffer.empty())
+		return res;
+
+	std::size_t h = head;
+	std::size_t n = std::min(h, buffer.size());
+	res.reserve(n);
+	for (std::size_t i = h - n; i < h; ++i)
+		res.push_back(buffer[i & mask]);
+	return res;
+}
+
+bool dumpChrome(const std::string & file) {
+	std::vector<Event> ev = events();
+
+	std::vector<std::string> stages;
+	{
+		boost::mutex::scoped_lock lock(names_mutex);
+		stages = names;
+	}
+
+	std::ofstream os(file.c_str());
+	if (!os)
+		return false;
+
+	// times are written in microseconds relative to the earliest event
+	double t0 = 0;
+	for (std::size_t i = 0; i < ev.size(); ++i) {
+		double t = std::min(ev[i].begin, ev[i].stamp.capture > 0 ? ev[i].stamp.capture : ev[i].begin);
+		if (i == 0 || t < t0)
+			t0 = t;
+	}
+
+	os.precision(3);
+	os << std::fixed;
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	const char * sep = "\n";
+	for (std::size_t i = 0; i < stages.size(); ++i, sep = ",\n") {
+		os << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+		   << ",\"args\":{\"name\":\"" << stages[i] << "\"}}";
+	}
+	for (std::size_t i = 0; i < ev.size(); ++i, sep = ",\n") {
+		const Event & e = ev[i];
+		os << sep << "{\"name\":\"" << (e.stage >= 0 && e.stage < (int) stages.size() ? stages[e.stage] : std::string("?"))
+		   << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.stage
+		   << ",\"ts\":" << (e.begin - t0) * 1e6 << ",\"dur\":" << (e.end - e.begin) * 1e6
+		   << ",\"args\":{\"seq\":" << e.stamp.seq << ",\"age_ms\":" << (e.end - e.stamp.capture) * 1e3 << "}}";
+	}
+	os << "\n]}\n";
+	return (bool) os;
+}
+
+} //: namespace Trace
+} //: namespace Types
@@ -0,0 +1,120 @@
+/*!
+ * \file
+ * \brief Process-wide ring buffer of pipeline stage timings
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "Stamp.hpp"
+
+namespace Types {
+namespace Trace {
+
+/*!
+ * \struct Event
+ * \brief Single execution of a stage on given frame.
+ */
+struct Event {
+	/// Stage id returned by stage()
+	int stage;
+	/// Frame being processed
+	Stamp stamp;
+	/// Start and end of processing (seconds, same clock as Stamp::capture)
+	double begin, end;
+};
+
+/*!
+ * Registers stage with given name (component name, usually) and returns its id.
+ * Registering the same name twice returns the same id.
+ */
+int stage(const std::string & name);
+
+/*!
+ * Starts recording, keeping at most capacity latest events. Events recorded
+ * so far are discarded.
+ */
+void enable(std::size_t capacity);
+
+/*!
+ * Stops recording. Buffer is kept, so it can be dumped afterwards.
+ */
+void disable();
+
+bool enabled();
+
+/*!
+ * Stores event in the ring buffer, overwriting the oldest one if it's full.
+ * Lock free, does nothing if recording is disabled.
+ */
+void record(int stage, const Stamp & stamp, double begin, double end);
+
+/*!
+ * Copies recorded events, oldest first. Events written concurrently with
+ * the copy may be torn, so it's best called after the pipeline stopped.
+ */
+std::vector<Event> events();
+
+/*!
+ * Writes recorded events in Chrome trace event format (chrome://tracing,
+ * Perfetto), one row per stage. Each event carries frame sequence number and
+ * its age at stage exit.
+ * \returns false if file can't be written
+ */
+bool dumpChrome(const std::string & file);
+
+/// Current time in seconds, on the clock used by stamps
+inline double now() {
+	return (double) cv::getTickCount() / cv::getTickFrequency();
+}
+
+/*!
+ * Newest stamp from input stream. If the source doesn't provide stamps, new
+ * one is made - captured now and numbered with (incremented) seq.
+ */
+template <typename Stream>
+Stamp readStamp(Stream & in, uint32_t & seq) {
+	if (in.empty())
+		return Stamp::make(now(), seq++);
+	Stamp s = in.read();
+	while (!in.empty())
+		s = in.read();
+	return s;
+}
+
+/*!
+ * \class Scope
+ * \brief Records time spent between construction and destruction.
+ */
+class Scope {
+public:
+	Scope(int stage, const Stamp & stamp) : m_stage(stage), m_stamp(stamp), m_begin(enabled() ? now() : 0) {
+	}
+
+	~Scope() {
+		if (m_begin > 0)
+			record(m_stage, m_stamp, m_begin, now());
+	}
+
+	/// Updates stamp, when it's known only after processing (asynchronous results)
+	void setStamp(const Stamp & stamp) {
+		m_stamp = stamp;
+	}
+
+private:
+	int m_stage;
+	Stamp m_stamp;
+	double m_begin;
+};
+
+} //: namespace Trace
+} //: namespace Types
+
+#endif /* TRACE_HPP_ */
@@ -0,0 +1,71 @@
+/*!
+ * \file
+ * \brief Tracked object state and fixed-capacity set of tracks
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef TRACK_HPP_
+#define TRACK_HPP_
+
+#include <stdint.h>
+
+namespace Types {
+
+/*!
+ * \struct Track
+ * \brief State of single tracked object (ball or feature point).
+ */
+struct Track {
+	/// Time the state refers to (seconds, cv::getTickCount() / cv::getTickFrequency())
+	double timestamp;
+	/// Identifier, constant for the whole life of the track
+	uint32_t id;
+	/// Number of consecutive updates without measurement
+	uint32_t lost;
+	/// Position and radius in pixels (radius is 0 for point tracks)
+	float x, y, r;
+	/// Velocity in pixels per second
+	float vx, vy;
+};
+
+/*!
+ * \struct TrackSet
+ * \brief All tracks of a single frame, stored inline.
+ *
+ * Capacity is fixed, so set is trivially copyable and passing it between
+ * components doesn't allocate. Tracks above capacity are dropped by add().
+ */
+struct TrackSet {
+	enum { Capacity = 1024 };
+
+	/// Time of the frame
+	double timestamp;
+	/// Frame sequence number
+	uint32_t id;
+	/// Number of valid entries in tracks
+	uint32_t count;
+	Track tracks[Capacity];
+
+	/// Empty set, tracks are left uninitialized
+	TrackSet() : timestamp(0), id(0), count(0) {
+	}
+
+	void clear() {
+		count = 0;
+	}
+
+	/*!
+	 * Appends track.
+	 * \returns false if set is full
+	 */
+	bool add(const Track & t) {
+		if (count >= Capacity)
+			return false;
+		tracks[count++] = t;
+		return true;
+	}
+};
+
+} //: namespace Types
+
+#endif /* TRACK_HPP_ */